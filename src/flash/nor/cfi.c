@@ -1263,21 +1263,16 @@ static int cfi_intel_write_block(struct flash_bank *bank, const uint8_t *buffer,
 
 	target_buffer_set_u32_array(target, target_code, target_code_size / 4, target_code_src);
 
-	/* Get memory for block write handler */
-	retval = target_alloc_working_area(target,
-			target_code_size,
+	/* Get memory for block write handler, with the code already loaded */
+	retval = target_alloc_loader(target, target_code, target_code_size,
 			&write_algorithm);
-	if (retval != ERROR_OK) {
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
 		LOG_WARNING("No working area available, can't do block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		return retval;
 	}
-
-	/* write algorithm code to working area */
-	retval = target_write_buffer(target, write_algorithm->address,
-			target_code_size, target_code);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Unable to write block write code to target");
-		goto cleanup;
+		return retval;
 	}
 
 	/* Get a workspace buffer for the data to flash starting with 32k size.
@@ -1502,23 +1497,12 @@ static int cfi_spansion_write_block_mips(struct flash_bank *bank, const uint8_t
 
 	target_buffer_set_u32_array(target, target_code, target_code_size / 4, target_code_src);
 
-	/* allocate working area */
-	retval = target_alloc_working_area(target, target_code_size,
+	/* allocate working area, with the code already loaded */
+	retval = target_alloc_loader(target, target_code, target_code_size,
 			&write_algorithm);
-	if (retval != ERROR_OK) {
-		free(target_code);
-		return retval;
-	}
-
-	/* write algorithm code to working area */
-	retval = target_write_buffer(target, write_algorithm->address,
-			target_code_size, target_code);
-	if (retval != ERROR_OK) {
-		free(target_code);
-		return retval;
-	}
-
 	free(target_code);
+	if (retval != ERROR_OK)
+		return retval;
 
 	/* the following code still assumes target code is fixed 24*4 bytes */
 
@@ -1881,23 +1865,12 @@ static int cfi_spansion_write_block(struct flash_bank *bank, const uint8_t *buff
 
 	target_buffer_set_u32_array(target, target_code, target_code_size / 4, target_code_src);
 
-	/* allocate working area */
-	retval = target_alloc_working_area(target, target_code_size,
+	/* allocate working area, with the code already loaded */
+	retval = target_alloc_loader(target, target_code, target_code_size,
 			&write_algorithm);
-	if (retval != ERROR_OK) {
-		free(target_code);
-		return retval;
-	}
-
-	/* write algorithm code to working area */
-	retval = target_write_buffer(target, write_algorithm->address,
-			target_code_size, target_code);
-	if (retval != ERROR_OK) {
-		free(target_code);
-		return retval;
-	}
-
 	free(target_code);
+	if (retval != ERROR_OK)
+		return retval;
 
 	/* the following code still assumes target code is fixed 24*4 bytes */
 
@@ -36,6 +36,7 @@
  */
 
 static struct flash_bank *flash_banks;
+static bool flash_compress;
 
 int flash_driver_erase(struct flash_bank *bank, int first, int last)
 {
@@ -302,6 +303,16 @@ int get_flash_bank_by_addr(struct target *target,
 	return ERROR_OK;
 }
 
+void flash_set_compress(bool enable)
+{
+	flash_compress = enable;
+}
+
+bool flash_get_compress(void)
+{
+	return flash_compress;
+}
+
 static int default_flash_mem_blank_check(struct flash_bank *bank)
 {
 	struct target *target = bank->target;
@@ -695,9 +706,155 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 	return aligned1 + bank->minimal_write_gap < aligned2;
 }
 
+static bool flash_buffer_is_blank(struct flash_bank *c, const uint8_t *buffer, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		if (buffer[i] != c->erased_value)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Write @a count bytes at @a offset into bank @a c right after erasing,
+ * leaving out the sectors the driver reports erased when their part of
+ * @a buffer holds nothing but the erased value. Programming those would
+ * only send padding over the debug link to leave the flash as it is.
+ */
+static int flash_write_nonblank(struct flash_bank *c, uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	/* start of the data not written yet */
+	uint32_t start = 0;
+	uint32_t pos = 0;
+	uint32_t skipped = 0;
+	int retval;
+
+	for (int sector = 0; sector < c->num_sectors && pos < count; sector++) {
+		struct flash_sector *s = &c->sectors[sector];
+
+		if (s->offset + s->size <= offset + pos)
+			continue;
+
+		uint32_t len = MIN(s->offset + s->size - (offset + pos), count - pos);
+
+		if (s->is_erased == 1 && flash_buffer_is_blank(c, buffer + pos, len)) {
+			if (pos > start) {
+				retval = flash_driver_write(c, buffer + start, offset + start, pos - start);
+				if (retval != ERROR_OK)
+					return retval;
+			}
+
+			skipped += len;
+			start = pos + len;
+		}
+
+		pos += len;
+	}
+
+	if (skipped)
+		LOG_INFO("not writing %" PRIu32 " bytes of blank sectors in %s", skipped, c->name);
+
+	if (start < count)
+		return flash_driver_write(c, buffer + start, offset + start, count - start);
+
+	return ERROR_OK;
+}
+
+/**
+ * Unlock, erase and write one run of the image to bank @a c, as asked for.
+ */
+static int flash_write_run(struct target *target, struct flash_bank *c,
+		uint8_t *buffer, target_addr_t run_address, uint32_t run_size,
+		int erase, bool unlock)
+{
+	int retval = ERROR_OK;
+
+	if (unlock)
+		retval = flash_unlock_address_range(target, run_address, run_size);
+	if (retval == ERROR_OK) {
+		if (erase) {
+			/* calculate and erase sectors */
+			retval = flash_erase_address_range(target,
+					true, run_address, run_size);
+		}
+	}
+
+	if (retval == ERROR_OK) {
+		/* write flash sectors */
+		if (erase)
+			retval = flash_write_nonblank(c, buffer, run_address - c->base, run_size);
+		else
+			retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+	}
+
+	return retval;
+}
+
+/**
+ * Write one run of the image sector by sector, leaving out the sectors
+ * whose contents on the target already match the image. The target
+ * contents are checked with target_checksum_memory(), which runs on the
+ * target where the target type supports it. Consecutive changed sectors
+ * are written together.
+ */
+static int flash_write_diff_run(struct target *target, struct flash_bank *c,
+		uint8_t *buffer, target_addr_t run_address, uint32_t run_size,
+		int erase, bool unlock, struct flash_write_diff *diff)
+{
+	uint32_t bank_offset = run_address - c->base;
+	/* start of the changed sectors not written yet */
+	uint32_t start = 0;
+	uint32_t pos = 0;
+	int retval;
+
+	for (int sector = 0; sector < c->num_sectors && pos < run_size; sector++) {
+		struct flash_sector *s = &c->sectors[sector];
+		uint32_t target_crc, image_crc;
+
+		if (s->offset + s->size <= bank_offset + pos)
+			continue;
+
+		uint32_t len = MIN(s->offset + s->size - (bank_offset + pos), run_size - pos);
+
+		retval = target_checksum_memory(target, run_address + pos, len, &target_crc);
+		if (retval != ERROR_OK)
+			return retval;
+
+		retval = image_calculate_checksum(buffer + pos, len, &image_crc);
+		if (retval != ERROR_OK)
+			return retval;
+
+		diff->sectors_checked++;
+
+		if (target_crc == image_crc) {
+			LOG_DEBUG("sector %d of %s unchanged", sector, c->name);
+
+			if (pos > start) {
+				retval = flash_write_run(target, c, buffer + start,
+						run_address + start, pos - start, erase, unlock);
+				if (retval != ERROR_OK)
+					return retval;
+			}
+
+			diff->sectors_skipped++;
+			diff->bytes_skipped += len;
+			start = pos + len;
+		}
+
+		pos += len;
+	}
+
+	if (start < run_size)
+		return flash_write_run(target, c, buffer + start,
+				run_address + start, run_size - start, erase, unlock);
+
+	return ERROR_OK;
+}
 
 int flash_write_unlock(struct target *target, struct image *image,
-	uint32_t *written, int erase, bool unlock)
+	uint32_t *written, int erase, bool unlock, struct flash_write_diff *diff_stats)
 {
 	int retval = ERROR_OK;
 
@@ -919,22 +1076,16 @@ int flash_write_unlock(struct target *target, struct image *image,
 			}
 		}
 
-		retval = ERROR_OK;
+		uint32_t bytes_skipped = 0;
 
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
-		}
-
-		if (retval == ERROR_OK) {
-			/* write flash sectors */
-			retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
-		}
+		if (diff_stats) {
+			bytes_skipped = diff_stats->bytes_skipped;
+			retval = flash_write_diff_run(target, c, buffer, run_address, run_size,
+					erase, unlock, diff_stats);
+			bytes_skipped = diff_stats->bytes_skipped - bytes_skipped;
+		} else
+			retval = flash_write_run(target, c, buffer, run_address, run_size,
+					erase, unlock);
 
 		free(buffer);
 
@@ -944,7 +1095,7 @@ int flash_write_unlock(struct target *target, struct image *image,
 		}
 
 		if (written != NULL)
-			*written += run_size;	/* add run size to total written counter */
+			*written += run_size - bytes_skipped;	/* add run size to total written counter */
 	}
 
 done:
@@ -957,7 +1108,7 @@ done:
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, int erase)
 {
-	return flash_write_unlock(target, image, written, erase, false);
+	return flash_write_unlock(target, image, written, erase, false, NULL);
 }
 
 struct flash_sector *alloc_block_array(uint32_t offset, uint32_t size, int num_blocks)
@@ -192,6 +192,15 @@ int flash_write(struct target *target,
  */
 void flash_set_dirty(void);
 
+/**
+ * Allows drivers to send data to their loaders compressed, for the
+ * loaders which can expand it.  Disabled by default.
+ */
+void flash_set_compress(bool enable);
+
+/** @returns true if drivers may send compressed data to their loaders. */
+bool flash_get_compress(void);
+
 /** @returns The number of flash banks currently defined. */
 int flash_get_bank_count(void);
 
@@ -42,8 +42,19 @@ int flash_driver_write(struct flash_bank *bank,
 int flash_driver_read(struct flash_bank *bank,
 		uint8_t *buffer, uint32_t offset, uint32_t count);
 
-/* write (optional verify) an image to flash memory of the given target */
+/** Statistics of a differential write, see flash_write_unlock() */
+struct flash_write_diff {
+	/** number of sectors compared with the target */
+	uint32_t sectors_checked;
+	/** number of sectors that already matched and were left alone */
+	uint32_t sectors_skipped;
+	/** image bytes in the skipped sectors */
+	uint32_t bytes_skipped;
+};
+
+/* write (optional verify) an image to flash memory of the given target,
+ * with diff_stats != NULL only the sectors that differ from the image */
 int flash_write_unlock(struct target *target, struct image *image,
-		uint32_t *written, int erase, bool unlock);
+		uint32_t *written, int erase, bool unlock, struct flash_write_diff *diff_stats);
 
 #endif /* OPENOCD_FLASH_NOR_IMP_H */
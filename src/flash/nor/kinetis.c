@@ -1269,14 +1269,12 @@ static int kinetis_write_block(struct flash_bank *bank, const uint8_t *buffer,
 		buffer_size = (target->working_area_size/2);
 
 	/* allocate working area with flash programming code */
-	if (target_alloc_working_area(target, sizeof(kinetis_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
+	retval = target_alloc_loader(target, kinetis_flash_write_code,
+			sizeof(kinetis_flash_write_code), &write_algorithm);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
 		LOG_WARNING("no working area available, can't do block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		return retval;
 	}
-
-	retval = target_write_buffer(target, write_algorithm->address,
-		sizeof(kinetis_flash_write_code), kinetis_flash_write_code);
 	if (retval != ERROR_OK)
 		return retval;
 
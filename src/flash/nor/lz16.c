@@ -0,0 +1,133 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include "lz16.h"
+
+#define LZ16_MIN_MATCH		3	/* a match costs two tokens */
+#define LZ16_HASH_BITS		12
+
+/* hash of the two halfwords at p */
+static unsigned lz16_hash(const uint8_t *p)
+{
+	return (le_to_h_u32(p) * 2654435761u) >> (32 - LZ16_HASH_BITS);
+}
+
+static uint32_t lz16_match_len(const uint8_t *in, uint32_t from, uint32_t pos, uint32_t max)
+{
+	uint32_t len = 0;
+
+	while (len < max && memcmp(in + 2 * (from + len), in + 2 * (pos + len), 2) == 0)
+		len++;
+
+	return len;
+}
+
+static uint8_t *lz16_put(uint8_t *out, uint16_t token)
+{
+	h_u16_to_le(out, token);
+	return out + 2;
+}
+
+static uint8_t *lz16_put_literals(uint8_t *out, const uint8_t *in, uint32_t count)
+{
+	while (count) {
+		uint32_t n = MIN(count, LZ16_MAX_LEN);
+
+		out = lz16_put(out, n);
+		memcpy(out, in, 2 * n);
+		out += 2 * n;
+		in += 2 * n;
+		count -= n;
+	}
+
+	return out;
+}
+
+/* Greedy parse: at each position the last one with the same hash and the
+ * previous halfword (runs) are tried as match sources. */
+int lz16_encode(const uint8_t *in, uint32_t count, uint32_t max_match,
+		uint8_t **out, uint32_t *out_count)
+{
+	/* literals only, plus one token per run of them */
+	uint8_t *stream = malloc(2 * (count + count / LZ16_MAX_LEN + 2));
+	uint32_t *table = calloc(1 << LZ16_HASH_BITS, sizeof(uint32_t));
+	uint8_t *p = stream;
+	uint32_t literals = 0;
+	uint32_t pos = 0;
+
+	if (stream == NULL || table == NULL) {
+		free(stream);
+		free(table);
+		return ERROR_FAIL;
+	}
+
+	if (max_match > LZ16_MAX_LEN)
+		max_match = LZ16_MAX_LEN;
+
+	while (pos < count) {
+		uint32_t max = MIN(max_match, count - pos);
+		uint32_t best_len = 0;
+		uint32_t best_distance = 0;
+
+		if (pos + 1 < count) {
+			unsigned h = lz16_hash(in + 2 * pos);
+			uint32_t from = table[h];
+
+			/* positions are stored + 1, 0 is empty */
+			table[h] = pos + 1;
+			if (from && pos - (from - 1) <= LZ16_MAX_DISTANCE) {
+				best_len = lz16_match_len(in, from - 1, pos, max);
+				best_distance = pos - (from - 1);
+			}
+		}
+
+		if (pos > 0 && best_len < max) {
+			uint32_t len = lz16_match_len(in, pos - 1, pos, max);
+			if (len > best_len) {
+				best_len = len;
+				best_distance = 1;
+			}
+		}
+
+		if (best_len < LZ16_MIN_MATCH) {
+			literals++;
+			pos++;
+			continue;
+		}
+
+		p = lz16_put_literals(p, in + 2 * (pos - literals), literals);
+		literals = 0;
+		p = lz16_put(p, LZ16_MATCH | best_len);
+		p = lz16_put(p, best_distance);
+
+		/* keep the positions inside the match findable */
+		for (uint32_t i = pos + 1; i < pos + best_len && i + 1 < count; i++)
+			table[lz16_hash(in + 2 * i)] = i + 1;
+		pos += best_len;
+	}
+
+	p = lz16_put_literals(p, in + 2 * (pos - literals), literals);
+
+	free(table);
+	*out = stream;
+	*out_count = (p - stream) / 2;
+
+	return ERROR_OK;
+}
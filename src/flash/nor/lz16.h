@@ -0,0 +1,51 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef OPENOCD_FLASH_NOR_LZ16_H
+#define OPENOCD_FLASH_NOR_LZ16_H
+
+/**
+ * @file
+ * lz16 is a minimal LZ77 format for flash loaders that program halfwords
+ * and expand the data on the target while programming. The stream is a
+ * sequence of little endian 16-bit tokens:
+ *
+ * - 0x0000 | n: n literal halfwords follow
+ * - 0x8000 | n, d: copy n halfwords starting d halfwords before the
+ *   current output position. The source may overlap the output, d = 1
+ *   repeats the previous halfword.
+ *
+ * n is 1 to LZ16_MAX_LEN, d is 1 to LZ16_MAX_DISTANCE. A matching decoder
+ * is contrib/loaders/flash/stm32/stm32f1x_lz16.S, which copies matches
+ * from the flash it has already programmed.
+ */
+
+#define LZ16_MATCH			0x8000
+#define LZ16_MAX_LEN		0x7FFF
+#define LZ16_MAX_DISTANCE	0xFFFF
+
+/**
+ * Compresses @a count halfwords at @a in into a newly allocated lz16
+ * stream, which the caller has to free.
+ * @param max_match Longest match to emit. It bounds how much output a
+ * decoder produces from a fifo full of tokens.
+ * @param out On return, the stream.
+ * @param out_count On return, the length of the stream in halfwords.
+ * @returns ERROR_OK if successful; otherwise, an error code.
+ */
+int lz16_encode(const uint8_t *in, uint32_t count, uint32_t max_match,
+		uint8_t **out, uint32_t *out_count);
+
+#endif /* OPENOCD_FLASH_NOR_LZ16_H */
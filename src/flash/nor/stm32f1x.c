@@ -27,6 +27,7 @@
 #endif
 
 #include "imp.h"
+#include "lz16.h"
 #include <helper/binarybuffer.h>
 #include <target/algorithm.h>
 #include <target/armv7m.h>
@@ -106,6 +107,12 @@
 #define FLASH_WRITE_TIMEOUT 10
 #define FLASH_ERASE_TIMEOUT 100
 
+/* compressed writes: a full fifo holds at most 512 matches of 128
+ * halfwords, about 4s of programming */
+
+#define STM32X_LZ16_MAX_MATCH	128
+#define STM32X_LZ16_FIFO_SIZE	2048
+
 struct stm32x_options {
 	uint8_t rdp;
 	uint8_t user;
@@ -473,17 +480,43 @@ static int stm32x_write_block(struct flash_bank *bank, const uint8_t *buffer,
 #include "../../../contrib/loaders/flash/stm32/stm32f1x.inc"
 	};
 
+	static const uint8_t stm32x_flash_write_lz16_code[] = {
+#include "../../../contrib/loaders/flash/stm32/stm32f1x_lz16.inc"
+	};
+
+	const uint8_t *code = stm32x_flash_write_code;
+	size_t code_size = sizeof(stm32x_flash_write_code);
+	const uint8_t *data = buffer;
+	uint32_t data_count = count;
+	uint8_t *stream = NULL;
+	uint32_t stream_count;
+
+	/* Send an lz16 stream instead if it saves at least a quarter. Matches
+	 * are limited and the fifo made smaller so that a full fifo still
+	 * expands to well under the time target_run_flash_async_algorithm()
+	 * waits for the loader to finish. */
+	if (flash_get_compress() && lz16_encode(buffer, count, STM32X_LZ16_MAX_MATCH,
+			&stream, &stream_count) == ERROR_OK) {
+		if (stream_count * 4 < count * 3) {
+			LOG_DEBUG("lz16 stream of %" PRIu32 " halfwords for %" PRIu32,
+					stream_count, count);
+			code = stm32x_flash_write_lz16_code;
+			code_size = sizeof(stm32x_flash_write_lz16_code);
+			data = stream;
+			data_count = stream_count;
+			buffer_size = STM32X_LZ16_FIFO_SIZE;
+		}
+	}
+
 	/* flash write code */
-	if (target_alloc_working_area(target, sizeof(stm32x_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
+	retval = target_alloc_loader(target, code, code_size, &write_algorithm);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
 		LOG_WARNING("no working area available, can't do block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		free(stream);
+		return retval;
 	}
-
-	retval = target_write_buffer(target, write_algorithm->address,
-			sizeof(stm32x_flash_write_code), stm32x_flash_write_code);
 	if (retval != ERROR_OK) {
-		target_free_working_area(target, write_algorithm);
+		free(stream);
 		return retval;
 	}
 
@@ -495,6 +528,7 @@ static int stm32x_write_block(struct flash_bank *bank, const uint8_t *buffer,
 			/* we already allocated the writing code, but failed to get a
 			 * buffer, free the algorithm */
 			target_free_working_area(target, write_algorithm);
+			free(stream);
 
 			LOG_WARNING("no large enough working area available, can't do block memory writes");
 			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
@@ -516,7 +550,7 @@ static int stm32x_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
 	armv7m_info.core_mode = ARM_MODE_THREAD;
 
-	retval = target_run_flash_async_algorithm(target, buffer, count, 2,
+	retval = target_run_flash_async_algorithm(target, data, data_count, 2,
 			0, NULL,
 			5, reg_params,
 			source->address, source->size,
@@ -542,6 +576,7 @@ static int stm32x_write_block(struct flash_bank *bank, const uint8_t *buffer,
 
 	target_free_working_area(target, source);
 	target_free_working_area(target, write_algorithm);
+	free(stream);
 
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
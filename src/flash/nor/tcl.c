@@ -403,30 +403,37 @@ COMMAND_HANDLER(handle_flash_protect_command)
 	return retval;
 }
 
-COMMAND_HANDLER(handle_flash_write_image_command)
-{
-	struct target *target = get_current_target(CMD_CTX);
-
-	struct image image;
-	uint32_t written;
-
-	int retval;
-
+/* options of flash write_image and flash gang_write_image */
+struct flash_write_image_opts {
 	/* flash auto-erase is disabled by default*/
-	int auto_erase = 0;
-	bool auto_unlock = false;
+	int auto_erase;
+	bool auto_unlock;
+	bool diff_write;
+};
 
+/**
+ * Parses the options of the write_image commands and opens the image.
+ * On return CMD_ARGV[0] is the file name.
+ */
+COMMAND_HELPER(flash_write_image_open, struct flash_write_image_opts *opts,
+		struct image *image)
+{
 	while (CMD_ARGC) {
 		if (strcmp(CMD_ARGV[0], "erase") == 0) {
-			auto_erase = 1;
+			opts->auto_erase = 1;
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD_CTX, "auto erase enabled");
 		} else if (strcmp(CMD_ARGV[0], "unlock") == 0) {
-			auto_unlock = true;
+			opts->auto_unlock = true;
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD_CTX, "auto unlock enabled");
+		} else if (strcmp(CMD_ARGV[0], "diff") == 0) {
+			opts->diff_write = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD_CTX, "unchanged sectors are skipped");
 		} else
 			break;
 	}
@@ -434,43 +441,131 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	if (CMD_ARGC < 1)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	if (!target) {
-		LOG_ERROR("no target selected");
-		return ERROR_FAIL;
+	if (CMD_ARGC >= 2) {
+		image->base_address_set = 1;
+		COMMAND_PARSE_NUMBER(llong, CMD_ARGV[1], image->base_address);
+	} else {
+		image->base_address_set = 0;
+		image->base_address = 0x0;
 	}
 
+	image->start_address_set = 0;
+
+	return image_open(image, CMD_ARGV[0], (CMD_ARGC == 3) ? CMD_ARGV[2] : NULL);
+}
+
+/**
+ * Writes the opened @a image to the flash banks of @a target and reports
+ * the amount written and the rate.
+ */
+COMMAND_HELPER(flash_write_image_target, struct flash_write_image_opts *opts,
+		struct image *image, struct target *target)
+{
+	struct flash_write_diff diff = { 0 };
 	struct duration bench;
+	uint32_t written;
+
 	duration_start(&bench);
 
-	if (CMD_ARGC >= 2) {
-		image.base_address_set = 1;
-		COMMAND_PARSE_NUMBER(llong, CMD_ARGV[1], image.base_address);
-	} else {
-		image.base_address_set = 0;
-		image.base_address = 0x0;
+	int retval = flash_write_unlock(target, image, &written, opts->auto_erase,
+			opts->auto_unlock, opts->diff_write ? &diff : NULL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (duration_measure(&bench) == ERROR_OK) {
+		command_print(CMD_CTX, "wrote %" PRIu32 " bytes from file %s "
+			"in %fs (%0.3f KiB/s)", written, CMD_ARGV[0],
+			duration_elapsed(&bench), duration_kbps(&bench, written));
+
+		if (opts->diff_write && diff.sectors_skipped) {
+			/* estimated from the rate achieved on the changed sectors */
+			if (written)
+				command_print(CMD_CTX, "skipped %" PRIu32 " of %" PRIu32 " sectors "
+					"(%" PRIu32 " bytes) already matching, about %fs saved",
+					diff.sectors_skipped, diff.sectors_checked, diff.bytes_skipped,
+					duration_elapsed(&bench) * diff.bytes_skipped / written);
+			else
+				command_print(CMD_CTX, "skipped %" PRIu32 " of %" PRIu32 " sectors "
+					"(%" PRIu32 " bytes) already matching",
+					diff.sectors_skipped, diff.sectors_checked, diff.bytes_skipped);
+		}
 	}
 
-	image.start_address_set = 0;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_flash_write_image_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct flash_write_image_opts opts = { 0 };
+	struct image image;
+	int retval;
 
-	retval = image_open(&image, CMD_ARGV[0], (CMD_ARGC == 3) ? CMD_ARGV[2] : NULL);
+	if (!target) {
+		LOG_ERROR("no target selected");
+		return ERROR_FAIL;
+	}
+
+	retval = CALL_COMMAND_HANDLER(flash_write_image_open, &opts, &image);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = flash_write_unlock(target, &image, &written, auto_erase, auto_unlock);
-	if (retval != ERROR_OK) {
-		image_close(&image);
-		return retval;
+	retval = CALL_COMMAND_HANDLER(flash_write_image_target, &opts, &image, target);
+
+	image_close(&image);
+
+	return retval;
+}
+
+static bool flash_target_has_bank(struct target *target)
+{
+	for (struct flash_bank *p = flash_bank_list(); p; p = p->next) {
+		if (p->target == target)
+			return true;
 	}
 
-	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
-		command_print(CMD_CTX, "wrote %" PRIu32 " bytes from file %s "
-			"in %fs (%0.3f KiB/s)", written, CMD_ARGV[0],
-			duration_elapsed(&bench), duration_kbps(&bench, written));
+	return false;
+}
+
+/**
+ * Writes one image to every target with a flash bank, e.g. all boards of
+ * a production fixture. A failing target doesn't stop the others.
+ */
+COMMAND_HANDLER(handle_flash_gang_write_image_command)
+{
+	struct flash_write_image_opts opts = { 0 };
+	struct image image;
+	int num_targets = 0, num_failed = 0;
+	int retval;
+
+	retval = CALL_COMMAND_HANDLER(flash_write_image_open, &opts, &image);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (struct target *target = all_targets; target; target = target->next) {
+		if (!flash_target_has_bank(target))
+			continue;
+
+		num_targets++;
+		command_print(CMD_CTX, "target %s: writing %s", target_name(target), CMD_ARGV[0]);
+
+		retval = CALL_COMMAND_HANDLER(flash_write_image_target, &opts, &image, target);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("target %s: flash write failed", target_name(target));
+			num_failed++;
+		}
 	}
 
 	image_close(&image);
 
-	return retval;
+	if (num_targets == 0) {
+		LOG_ERROR("no target has a flash bank");
+		return ERROR_FAIL;
+	}
+
+	command_print(CMD_CTX, "wrote %d of %d targets", num_targets - num_failed, num_targets);
+
+	return num_failed ? ERROR_FAIL : ERROR_OK;
 }
 
 COMMAND_HANDLER(handle_flash_fill_command)
@@ -958,6 +1053,23 @@ COMMAND_HANDLER(handle_flash_padded_value_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_flash_compress_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+		flash_set_compress(enable);
+	}
+
+	command_print(CMD_CTX, "compressed flash writes %s",
+			flash_get_compress() ? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
 static const struct command_registration flash_exec_command_handlers[] = {
 	{
 		.name = "probe",
@@ -1038,11 +1150,21 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.name = "write_image",
 		.handler = handle_flash_write_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "[erase] [unlock] filename [offset [file_type]]",
+		.usage = "[erase] [unlock] [diff] filename [offset [file_type]]",
 		.help = "Write an image to flash.  Optionally first unprotect "
-			"and/or erase the region to be used.  Allow optional "
+			"and/or erase the region to be used, and skip sectors "
+			"already holding the image data.  Allow optional "
 			"offset from beginning of bank (defaults to zero)",
 	},
+	{
+		.name = "gang_write_image",
+		.handler = handle_flash_gang_write_image_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[erase] [unlock] [diff] filename [offset [file_type]]",
+		.help = "Write an image to the flash of every target having "
+			"a flash bank, one after the other, and report which "
+			"failed.  Options as for write_image.",
+	},
 	{
 		.name = "read_bank",
 		.handler = handle_flash_read_bank_command,
@@ -1077,6 +1199,14 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.usage = "bank_id value",
 		.help = "Set default flash padded value",
 	},
+	{
+		.name = "compress",
+		.handler = handle_flash_compress_command,
+		.mode = COMMAND_ANY,
+		.usage = "['enable'|'disable']",
+		.help = "Send flash data compressed to the loaders which "
+			"support it.",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
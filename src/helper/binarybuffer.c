@@ -50,6 +50,26 @@ static const char hex_digits[] = {
 	'a', 'b', 'c', 'd', 'e', 'f'
 };
 
+/* value of a hexadecimal digit, 0xFF for any other character */
+static const unsigned char hex_values[] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
 void *buf_cpy(const void *from, void *_to, unsigned size)
 {
 	if (NULL == from || NULL == _to)
@@ -133,7 +153,7 @@ void *buf_set_buf(const void *_src, unsigned src_start,
 {
 	const uint8_t *src = _src;
 	uint8_t *dst = _dst;
-	unsigned i, sb, db, sq, dq, lb, lq;
+	unsigned sb, db, sq, dq, lb, lq;
 
 	sb = src_start / 8;
 	db = dst_start / 8;
@@ -149,22 +169,45 @@ void *buf_set_buf(const void *_src, unsigned src_start,
 	 * len is a multiple of 8bit so we can simple copy
 	 * the buffer */
 	if ((sq == 0) && (dq == 0) &&  (lq == 0)) {
-		for (i = 0; i < lb; i++)
-			*dst++ = *src++;
+		memcpy(dst, src, lb);
 		return _dst;
 	}
 
-	/* fallback to slow bit copy */
-	for (i = 0; i < len; i++) {
-		if (((*src >> (sq&7)) & 1) == 1)
-			*dst |= 1 << (dq&7);
-		else
-			*dst &= ~(1 << (dq&7));
-		if (sq++ == 7) {
-			sq = 0;
+	/* same bit position in both buffers: merge the partial first and
+	 * last bytes, copy the whole bytes in between */
+	if (sq == dq) {
+		if (dq) {
+			unsigned n = 8 - dq < len ? 8 - dq : len;
+			uint8_t mask = ((1 << n) - 1) << dq;
+			*dst = (*dst & ~mask) | (*src & mask);
+			dst++;
 			src++;
+			len -= n;
+		}
+		memcpy(dst, src, len / 8);
+		lq = len % 8;
+		if (lq) {
+			uint8_t mask = (1 << lq) - 1;
+			dst[len / 8] = (dst[len / 8] & ~mask) | (src[len / 8] & mask);
 		}
-		if (dq++ == 7) {
+		return _dst;
+	}
+
+	/* fill the destination up to a byte at a time */
+	while (len > 0) {
+		unsigned n = 8 - dq < len ? 8 - dq : len;
+		unsigned value = *src >> sq;
+		if (sq + n > 8)
+			value |= src[1] << (8 - sq);
+		uint8_t mask = (1 << n) - 1;
+		*dst = (*dst & ~(mask << dq)) | ((value & mask) << dq);
+
+		len -= n;
+		sq += n;
+		src += sq / 8;
+		sq %= 8;
+		dq += n;
+		if (dq == 8) {
 			dq = 0;
 			dst++;
 		}
@@ -339,7 +382,22 @@ void bit_copy_queue_init(struct bit_copy_queue *q)
 int bit_copy_queued(struct bit_copy_queue *q, uint8_t *dst, unsigned dst_offset, const uint8_t *src,
 	unsigned src_offset, unsigned bit_count)
 {
-	struct bit_copy_queue_entry *qe = malloc(sizeof(*qe));
+	struct bit_copy_queue_entry *qe;
+
+	/* extend the last copy if this one continues it in both buffers */
+	if (!list_empty(&q->list)) {
+		qe = list_entry(q->list.prev, struct bit_copy_queue_entry, list);
+		unsigned dst_end = qe->dst_offset + qe->bit_count;
+		unsigned src_end = qe->src_offset + qe->bit_count;
+		if (qe->dst + dst_end / 8 == dst + dst_offset / 8 && dst_end % 8 == dst_offset % 8
+				&& qe->src + src_end / 8 == src + src_offset / 8
+				&& src_end % 8 == src_offset % 8) {
+			qe->bit_count += bit_count;
+			return ERROR_OK;
+		}
+	}
+
+	qe = malloc(sizeof(*qe));
 	if (!qe)
 		return ERROR_FAIL;
 
@@ -389,27 +447,28 @@ void bit_copy_discard(struct bit_copy_queue *q)
 size_t unhexify(uint8_t *bin, const char *hex, size_t count)
 {
 	size_t i;
-	char tmp;
+	uint8_t high, low;
 
 	if (!bin || !hex)
 		return 0;
 
-	memset(bin, 0, count);
-
-	for (i = 0; i < 2 * count; i++) {
-		if (hex[i] >= 'a' && hex[i] <= 'f')
-			tmp = hex[i] - 'a' + 10;
-		else if (hex[i] >= 'A' && hex[i] <= 'F')
-			tmp = hex[i] - 'A' + 10;
-		else if (hex[i] >= '0' && hex[i] <= '9')
-			tmp = hex[i] - '0';
-		else
-			return i / 2;
-
-		bin[i / 2] |= tmp << (4 * ((i + 1) % 2));
+	for (i = 0; i < count; i++) {
+		high = hex_values[(unsigned char)hex[2 * i]];
+		if (high == 0xFF)
+			break;
+		low = hex_values[(unsigned char)hex[2 * i + 1]];
+		if (low == 0xFF) {
+			/* keep the digit that was converted */
+			bin[i] = high << 4;
+			memset(bin + i + 1, 0, count - i - 1);
+			return i;
+		}
+		bin[i] = (high << 4) | low;
 	}
 
-	return i / 2;
+	memset(bin + i, 0, count - i);
+
+	return i;
 }
 
 /**
@@ -426,15 +485,22 @@ size_t unhexify(uint8_t *bin, const char *hex, size_t count)
  */
 size_t hexify(char *hex, const uint8_t *bin, size_t count, size_t length)
 {
-	size_t i;
-	uint8_t tmp;
+	size_t i, n;
 
 	if (!length)
 		return 0;
 
-	for (i = 0; i < length - 1 && i < 2 * count; i++) {
-		tmp = (bin[i / 2] >> (4 * ((i + 1) % 2))) & 0x0f;
-		hex[i] = hex_digits[tmp];
+	n = 2 * count < length - 1 ? 2 * count : length - 1;
+
+	for (i = 0; i + 1 < n; i += 2) {
+		hex[i] = hex_digits[bin[i / 2] >> 4];
+		hex[i + 1] = hex_digits[bin[i / 2] & 0x0f];
+	}
+
+	/* odd length limit, only the high nibble fits */
+	if (i < n) {
+		hex[i] = hex_digits[bin[i / 2] >> 4];
+		i++;
 	}
 
 	hex[i] = 0;
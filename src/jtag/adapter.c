@@ -34,6 +34,7 @@
 #include "minidriver.h"
 #include "interface.h"
 #include "interfaces.h"
+#include "swd.h"
 #include <transport/transport.h>
 #include <jtag/drivers/jtag_usb_common.h>
 
@@ -580,5 +581,9 @@ static const struct command_registration interface_command_handlers[] = {
  */
 int interface_register_commands(struct command_context *ctx)
 {
+	int retval = swd_trace_register_commands(ctx);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return register_commands(ctx, NULL, interface_command_handlers);
 }
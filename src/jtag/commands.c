@@ -40,8 +40,15 @@ struct cmd_queue_page {
 };
 
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
+/* number of free pages kept around for the next queues */
+#define CMD_QUEUE_POOL_PAGES 4
 static struct cmd_queue_page *cmd_queue_pages;
 static struct cmd_queue_page *cmd_queue_pages_tail;
+/* pages of previous queues, reused by cmd_queue_alloc() */
+static struct cmd_queue_page *cmd_queue_pool;
+/* allocations that don't fit in a page, freed with the queue */
+static struct cmd_queue_page *cmd_queue_oversize;
+static struct cmd_queue_stats cmd_queue_stats;
 
 struct jtag_command *jtag_command_queue;
 static struct jtag_command **next_command_pointer = &jtag_command_queue;
@@ -62,8 +69,8 @@ void jtag_queue_command(struct jtag_command *cmd)
 
 void *cmd_queue_alloc(size_t size)
 {
-	struct cmd_queue_page **p_page = &cmd_queue_pages;
-	int offset;
+	struct cmd_queue_page *page;
+	size_t offset;
 	uint8_t *t;
 
 	/*
@@ -98,42 +105,87 @@ void *cmd_queue_alloc(size_t size)
 	size = (size + ALIGN_SIZE - 1) & (~(ALIGN_SIZE - 1));
 	/* Done... */
 
-	if (*p_page) {
-		p_page = &cmd_queue_pages_tail;
-		if (CMD_QUEUE_PAGE_SIZE - (*p_page)->used < size)
-			p_page = &((*p_page)->next);
+	/* requests larger than a page get a buffer of their own, which
+	 * leaves the tail page available for the following requests */
+	if (size > CMD_QUEUE_PAGE_SIZE) {
+		page = malloc(sizeof(struct cmd_queue_page));
+		page->address = malloc(size);
+		page->used = size;
+		page->next = cmd_queue_oversize;
+		cmd_queue_oversize = page;
+		cmd_queue_stats.oversize_allocs++;
+		return page->address;
 	}
 
-	if (!*p_page) {
-		*p_page = malloc(sizeof(struct cmd_queue_page));
-		(*p_page)->used = 0;
-		size_t alloc_size = (size < CMD_QUEUE_PAGE_SIZE) ?
-					CMD_QUEUE_PAGE_SIZE : size;
-		(*p_page)->address = malloc(alloc_size);
-		(*p_page)->next = NULL;
-		cmd_queue_pages_tail = *p_page;
+	page = cmd_queue_pages_tail;
+	if (!page || CMD_QUEUE_PAGE_SIZE - page->used < size) {
+		page = cmd_queue_pool;
+		if (page) {
+			cmd_queue_pool = page->next;
+			cmd_queue_stats.pages_pooled--;
+		} else {
+			page = malloc(sizeof(struct cmd_queue_page));
+			page->address = malloc(CMD_QUEUE_PAGE_SIZE);
+			cmd_queue_stats.pages_allocated++;
+		}
+		page->used = 0;
+		page->next = NULL;
+
+		if (cmd_queue_pages_tail)
+			cmd_queue_pages_tail->next = page;
+		else
+			cmd_queue_pages = page;
+		cmd_queue_pages_tail = page;
+
+		cmd_queue_stats.pages_in_use++;
+		if (cmd_queue_stats.pages_in_use > cmd_queue_stats.pages_high_water)
+			cmd_queue_stats.pages_high_water = cmd_queue_stats.pages_in_use;
 	}
 
-	offset = (*p_page)->used;
-	(*p_page)->used += size;
+	offset = page->used;
+	page->used += size;
 
-	t = (*p_page)->address;
+	t = page->address;
 	return t + offset;
 }
 
+static void cmd_queue_page_free(struct cmd_queue_page *page)
+{
+	free(page->address);
+	free(page);
+}
+
 static void cmd_queue_free(void)
 {
-	struct cmd_queue_page *page = cmd_queue_pages;
+	while (cmd_queue_oversize) {
+		struct cmd_queue_page *page = cmd_queue_oversize;
+		cmd_queue_oversize = page->next;
+		cmd_queue_page_free(page);
+	}
+
+	/* hand all pages of the queue back to the pool at once, it is only
+	 * trimmed after a queue that needed more pages than the pool keeps */
+	if (cmd_queue_pages) {
+		cmd_queue_pages_tail->next = cmd_queue_pool;
+		cmd_queue_pool = cmd_queue_pages;
+		cmd_queue_stats.pages_pooled += cmd_queue_stats.pages_in_use;
+	}
 
-	while (page) {
-		struct cmd_queue_page *last = page;
-		free(page->address);
-		page = page->next;
-		free(last);
+	while (cmd_queue_stats.pages_pooled > CMD_QUEUE_POOL_PAGES) {
+		struct cmd_queue_page *page = cmd_queue_pool;
+		cmd_queue_pool = page->next;
+		cmd_queue_page_free(page);
+		cmd_queue_stats.pages_pooled--;
 	}
 
 	cmd_queue_pages = NULL;
 	cmd_queue_pages_tail = NULL;
+	cmd_queue_stats.pages_in_use = 0;
+}
+
+void cmd_queue_get_stats(struct cmd_queue_stats *stats)
+{
+	*stats = cmd_queue_stats;
 }
 
 void jtag_command_queue_reset(void)
@@ -183,6 +235,83 @@ int jtag_scan_size(const struct scan_command *cmd)
 	return bit_count;
 }
 
+/* Copy num_bits from src to the zero initialized scan buffer dst at bit offset
+ * dst_offset. Fields are packed in ascending order, so bits above the field may
+ * be overwritten. Unlike buf_set_buf() this never goes bit by bit. */
+static void jtag_pack_bits(uint8_t *dst, unsigned dst_offset, const uint8_t *src,
+		unsigned num_bits)
+{
+	unsigned shift = dst_offset % 8;
+	unsigned bytes = DIV_ROUND_UP(num_bits, 8);
+	unsigned trailing_bits = num_bits % 8;
+
+	dst += dst_offset / 8;
+
+	if (shift == 0) {
+		memcpy(dst, src, bytes);
+		if (trailing_bits)
+			dst[bytes - 1] &= (1 << trailing_bits) - 1;
+		return;
+	}
+
+	if (num_bits <= 32) {
+		/* the common DAP and instruction register fields fit in one word */
+		uint64_t value = 0;
+		for (unsigned i = 0; i < bytes; i++)
+			value |= (uint64_t)src[i] << (8 * i);
+		value &= (UINT64_C(1) << num_bits) - 1;
+		value <<= shift;
+		for (unsigned i = 0; i < DIV_ROUND_UP(shift + num_bits, 8); i++)
+			dst[i] |= value >> (8 * i);
+		return;
+	}
+
+	for (unsigned i = 0; i < bytes; i++) {
+		uint8_t b = src[i];
+		unsigned bits = 8;
+		if (i == bytes - 1 && trailing_bits) {
+			b &= (1 << trailing_bits) - 1;
+			bits = trailing_bits;
+		}
+		dst[i] |= b << shift;
+		if (shift + bits > 8)
+			dst[i + 1] |= b >> (8 - shift);
+	}
+}
+
+/* Copy num_bits at bit offset src_offset of the scan buffer src to dst, clearing
+ * the unused bits of the last byte of dst the same way buf_cpy() does. */
+static void jtag_unpack_bits(uint8_t *dst, const uint8_t *src, unsigned src_offset,
+		unsigned num_bits)
+{
+	unsigned shift = src_offset % 8;
+	unsigned bytes = DIV_ROUND_UP(num_bits, 8);
+	unsigned trailing_bits = num_bits % 8;
+
+	src += src_offset / 8;
+
+	if (shift == 0) {
+		memcpy(dst, src, bytes);
+	} else if (num_bits <= 32) {
+		uint64_t value = 0;
+		for (unsigned i = 0; i < DIV_ROUND_UP(shift + num_bits, 8); i++)
+			value |= (uint64_t)src[i] << (8 * i);
+		value >>= shift;
+		for (unsigned i = 0; i < bytes; i++)
+			dst[i] = value >> (8 * i);
+	} else {
+		for (unsigned i = 0; i < bytes; i++) {
+			uint8_t b = src[i] >> shift;
+			if (8 * i + 8 - shift < num_bits)
+				b |= src[i + 1] << (8 - shift);
+			dst[i] = b;
+		}
+	}
+
+	if (trailing_bits)
+		dst[bytes - 1] &= (1 << trailing_bits) - 1;
+}
+
 int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer)
 {
 	int bit_count = 0;
@@ -209,8 +338,8 @@ int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer)
 					cmd->fields[i].num_bits, char_buf);
 			free(char_buf);
 #endif
-			buf_set_buf(cmd->fields[i].out_value, 0, *buffer,
-					bit_count, cmd->fields[i].num_bits);
+			jtag_pack_bits(*buffer, bit_count, cmd->fields[i].out_value,
+					cmd->fields[i].num_bits);
 		} else {
 			DEBUG_JTAG_IO("fields[%i].out_value[%i]: NULL",
 					i, cmd->fields[i].num_bits);
@@ -239,8 +368,9 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 		 */
 		if (cmd->fields[i].in_value) {
 			int num_bits = cmd->fields[i].num_bits;
-			uint8_t *captured = buf_set_buf(buffer, bit_count,
-					malloc(DIV_ROUND_UP(num_bits, 8)), 0, num_bits);
+			uint8_t *captured = cmd->fields[i].in_value;
+
+			jtag_unpack_bits(captured, buffer, bit_count, num_bits);
 
 #ifdef _DEBUG_JTAG_IO_
 			char *char_buf = buf_to_str(captured,
@@ -252,11 +382,6 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 					i, num_bits, char_buf);
 			free(char_buf);
 #endif
-
-			if (cmd->fields[i].in_value)
-				buf_cpy(captured, cmd->fields[i].in_value, num_bits);
-
-			free(captured);
 		}
 		bit_count += cmd->fields[i].num_bits;
 	}
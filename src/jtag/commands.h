@@ -163,7 +163,22 @@ struct jtag_command {
 /** The current queue of jtag_command_s structures. */
 extern struct jtag_command *jtag_command_queue;
 
+/** Allocation counters of the command queue memory. */
+struct cmd_queue_stats {
+	/** pages holding the current queue */
+	unsigned int pages_in_use;
+	/** most pages used by a single queue */
+	unsigned int pages_high_water;
+	/** free pages kept for the next queues */
+	unsigned int pages_pooled;
+	/** pages obtained from malloc() so far */
+	unsigned long pages_allocated;
+	/** requests too large for a page, allocated on their own */
+	unsigned long oversize_allocs;
+};
+
 void *cmd_queue_alloc(size_t size);
+void cmd_queue_get_stats(struct cmd_queue_stats *stats);
 
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
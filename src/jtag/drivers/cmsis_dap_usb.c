@@ -39,6 +39,9 @@
 #include <jtag/tcl.h>
 
 #include <hidapi.h>
+#ifdef HAVE_LIBUSB1
+#include <libusb.h>
+#endif
 
 /*
  * See CMSIS-DAP documentation:
@@ -163,8 +166,18 @@ static const char * const info_caps_str[] = {
 /* max clock speed (kHz) */
 #define DAP_MAX_CLOCK             5000
 
+struct cmsis_dap_backend;
+
 struct cmsis_dap {
+	const struct cmsis_dap_backend *backend;
 	hid_device *dev_handle;
+#ifdef HAVE_LIBUSB1
+	libusb_context *usb_ctx;
+	libusb_device_handle *usb_handle;
+	int usb_interface;
+	uint8_t ep_out;
+	uint8_t ep_in;
+#endif
 	uint16_t packet_size;
 	int packet_count;
 	uint8_t *packet_buffer;
@@ -179,6 +192,8 @@ struct pending_transfer_result {
 };
 
 struct pending_request_block {
+	/* CMD_DAP_TFER, or CMD_DAP_TFER_BLOCK for accesses to one AP register */
+	uint8_t command;
 	struct pending_transfer_result *transfers;
 	int transfer_count;
 };
@@ -195,12 +210,16 @@ struct pending_scan_result {
 };
 
 /* Up to MIN(packet_count, MAX_PENDING_REQUESTS) requests may be issued
- * until the first response arrives */
-#define MAX_PENDING_REQUESTS 3
+ * until the first response arrives. HID adapters are limited further,
+ * to MAX_PENDING_REQUESTS_HID. */
+#define MAX_PENDING_REQUESTS 8
+#define MAX_PENDING_REQUESTS_HID 3
 
 /* Pending requests are organized as a FIFO - circular buffer */
-/* Each block in FIFO can contain up to pending_queue_len transfers */
+/* Each block in FIFO can contain up to pending_queue_len transfers,
+ * or pending_block_len if it is sent as DAP_TransferBlock */
 static int pending_queue_len;
+static int pending_block_len;
 static struct pending_request_block pending_fifo[MAX_PENDING_REQUESTS];
 static int pending_fifo_put_idx, pending_fifo_get_idx;
 static int pending_fifo_block_count;
@@ -223,7 +242,21 @@ static uint8_t output_pins = SWJ_PIN_SRST | SWJ_PIN_TRST;
 
 static struct cmsis_dap *cmsis_dap_handle;
 
-static int cmsis_dap_usb_open(void)
+/* name of the backend to use, NULL to try all */
+static char *cmsis_dap_backend_name;
+
+struct cmsis_dap_backend {
+	const char *name;
+	int (*open)(struct cmsis_dap *dap);
+	void (*close)(struct cmsis_dap *dap);
+	/* returns the number of bytes read, 0 on timeout or -1 on error */
+	int (*read)(struct cmsis_dap *dap, int timeout_ms);
+	int (*write)(struct cmsis_dap *dap, int txlen);
+	/* upper limit for the number of requests in flight */
+	int max_pending;
+};
+
+static int cmsis_dap_hid_open(struct cmsis_dap *dap)
 {
 	hid_device *dev = NULL;
 	int i;
@@ -295,7 +328,7 @@ static int cmsis_dap_usb_open(void)
 	hid_free_enumeration(devs);
 
 	if (target_vid == 0 && target_pid == 0) {
-		LOG_ERROR("unable to find CMSIS-DAP device");
+		LOG_DEBUG("no CMSIS-DAP HID device found");
 		return ERROR_FAIL;
 	}
 
@@ -311,19 +344,9 @@ static int cmsis_dap_usb_open(void)
 		return ERROR_FAIL;
 	}
 
-	struct cmsis_dap *dap = malloc(sizeof(struct cmsis_dap));
-	if (dap == NULL) {
-		LOG_ERROR("unable to allocate memory");
-		return ERROR_FAIL;
-	}
-
 	dap->dev_handle = dev;
-	dap->caps = 0;
-	dap->mode = 0;
 
-	cmsis_dap_handle = dap;
-
-	/* allocate default packet buffer, may be changed later.
+	/* default packet size, may be changed later.
 	 * currently with HIDAPI we have no way of getting the output report length
 	 * without this info we cannot communicate with the adapter.
 	 * For the moment we ahve to hard code the packet size */
@@ -338,9 +361,269 @@ static int cmsis_dap_usb_open(void)
 	if (target_vid == 0x03eb && target_pid != 0x2145)
 		packet_size = 512 + 1;
 
-	cmsis_dap_handle->packet_buffer = malloc(packet_size);
-	cmsis_dap_handle->packet_size = packet_size;
+	dap->packet_size = packet_size;
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_hid_close(struct cmsis_dap *dap)
+{
+	hid_close(dap->dev_handle);
+	hid_exit();
+}
+
+static int cmsis_dap_hid_read(struct cmsis_dap *dap, int timeout_ms)
+{
+	int retval = hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, timeout_ms);
+	if (retval == -1)
+		LOG_DEBUG("error reading data: %ls", hid_error(dap->dev_handle));
+
+	return retval;
+}
+
+static int cmsis_dap_hid_write(struct cmsis_dap *dap, int txlen)
+{
+	/* Pad the rest of the TX buffer with 0's */
+	memset(dap->packet_buffer + txlen, 0, dap->packet_size - txlen);
+
+	/* write data to device */
+	int retval = hid_write(dap->dev_handle, dap->packet_buffer, dap->packet_size);
+	if (retval == -1) {
+		LOG_ERROR("error writing data: %ls", hid_error(dap->dev_handle));
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static const struct cmsis_dap_backend cmsis_dap_hid_backend = {
+	.name = "hid",
+	.open = cmsis_dap_hid_open,
+	.close = cmsis_dap_hid_close,
+	.read = cmsis_dap_hid_read,
+	.write = cmsis_dap_hid_write,
+	.max_pending = MAX_PENDING_REQUESTS_HID,
+};
+
+#ifdef HAVE_LIBUSB1
+static bool cmsis_dap_usb_bulk_match_id(uint16_t vid, uint16_t pid)
+{
+	/* without vid:pid the interface string identifies the adapter */
+	if (!cmsis_dap_vid[0] && !cmsis_dap_pid[0])
+		return true;
+
+	for (int i = 0; cmsis_dap_vid[i] || cmsis_dap_pid[i]; i++) {
+		if (cmsis_dap_vid[i] == vid && cmsis_dap_pid[i] == pid)
+			return true;
+	}
 
+	return false;
+}
+
+static bool cmsis_dap_usb_bulk_match_serial(libusb_device_handle *handle, uint8_t index)
+{
+	char serial[256] = "";
+	size_t i;
+
+	if (!cmsis_dap_serial)
+		return true;
+
+	if (index)
+		libusb_get_string_descriptor_ascii(handle, index, (unsigned char *)serial, sizeof(serial));
+
+	for (i = 0; serial[i] && cmsis_dap_serial[i] == (unsigned char)serial[i]; i++)
+		;
+
+	return !serial[i] && !cmsis_dap_serial[i];
+}
+
+/*
+ * The CMSIS-DAP v2 interface is vendor specific, its interface string
+ * contains "CMSIS-DAP" and its first two endpoints are bulk OUT and bulk IN.
+ */
+static bool cmsis_dap_usb_bulk_find_interface(struct cmsis_dap *dap,
+		libusb_device *dev, libusb_device_handle *handle)
+{
+	struct libusb_config_descriptor *config;
+	bool found = false;
+
+	if (libusb_get_active_config_descriptor(dev, &config) != LIBUSB_SUCCESS)
+		return false;
+
+	for (int i = 0; i < config->bNumInterfaces && !found; i++) {
+		const struct libusb_interface_descriptor *intf = &config->interface[i].altsetting[0];
+		char name[256];
+
+		if (intf->bInterfaceClass != LIBUSB_CLASS_VENDOR_SPEC || intf->bNumEndpoints < 2
+				|| !intf->iInterface)
+			continue;
+
+		const struct libusb_endpoint_descriptor *ep_out = &intf->endpoint[0];
+		const struct libusb_endpoint_descriptor *ep_in = &intf->endpoint[1];
+
+		if ((ep_out->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) != LIBUSB_TRANSFER_TYPE_BULK
+				|| (ep_out->bEndpointAddress & LIBUSB_ENDPOINT_IN)
+				|| (ep_in->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) != LIBUSB_TRANSFER_TYPE_BULK
+				|| !(ep_in->bEndpointAddress & LIBUSB_ENDPOINT_IN))
+			continue;
+
+		if (libusb_get_string_descriptor_ascii(handle, intf->iInterface,
+				(unsigned char *)name, sizeof(name)) < 0 || !strstr(name, "CMSIS-DAP"))
+			continue;
+
+		dap->usb_interface = intf->bInterfaceNumber;
+		dap->ep_out = ep_out->bEndpointAddress;
+		dap->ep_in = ep_in->bEndpointAddress;
+		/* default packet size, may be changed later */
+		dap->packet_size = (ep_out->wMaxPacketSize & 0x7ff) + 1;
+		found = true;
+	}
+
+	libusb_free_config_descriptor(config);
+
+	return found;
+}
+
+static int cmsis_dap_usb_bulk_open(struct cmsis_dap *dap)
+{
+	libusb_device **devs;
+	libusb_device_handle *handle = NULL;
+
+	if (libusb_init(&dap->usb_ctx) != LIBUSB_SUCCESS) {
+		LOG_ERROR("unable to initialize libusb");
+		return ERROR_FAIL;
+	}
+
+	ssize_t count = libusb_get_device_list(dap->usb_ctx, &devs);
+	for (ssize_t i = 0; i < count; i++) {
+		struct libusb_device_descriptor desc;
+
+		if (libusb_get_device_descriptor(devs[i], &desc) != LIBUSB_SUCCESS
+				|| !cmsis_dap_usb_bulk_match_id(desc.idVendor, desc.idProduct))
+			continue;
+
+		if (libusb_open(devs[i], &handle) != LIBUSB_SUCCESS) {
+			handle = NULL;
+			continue;
+		}
+
+		if (cmsis_dap_usb_bulk_find_interface(dap, devs[i], handle)
+				&& cmsis_dap_usb_bulk_match_serial(handle, desc.iSerialNumber)) {
+			int retval = libusb_claim_interface(handle, dap->usb_interface);
+			if (retval == LIBUSB_SUCCESS)
+				break;
+			LOG_DEBUG("unable to claim interface %d of 0x%04x:0x%04x: %s",
+				dap->usb_interface, desc.idVendor, desc.idProduct, libusb_error_name(retval));
+		}
+
+		libusb_close(handle);
+		handle = NULL;
+	}
+
+	if (count >= 0)
+		libusb_free_device_list(devs, 1);
+
+	if (!handle) {
+		LOG_DEBUG("no CMSIS-DAP v2 device found");
+		libusb_exit(dap->usb_ctx);
+		dap->usb_ctx = NULL;
+		return ERROR_FAIL;
+	}
+
+	dap->usb_handle = handle;
+	LOG_INFO("CMSIS-DAP: using USB bulk interface %d", dap->usb_interface);
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_usb_bulk_close(struct cmsis_dap *dap)
+{
+	libusb_release_interface(dap->usb_handle, dap->usb_interface);
+	libusb_close(dap->usb_handle);
+	libusb_exit(dap->usb_ctx);
+}
+
+static int cmsis_dap_usb_bulk_read(struct cmsis_dap *dap, int timeout_ms)
+{
+	int transferred = 0;
+
+	/* A synchronous transfer can't poll, libusb waits forever with a
+	 * timeout of 0. Report no data, the response is picked up by the
+	 * next waiting read. */
+	if (timeout_ms == 0)
+		return 0;
+
+	int retval = libusb_bulk_transfer(dap->usb_handle, dap->ep_in, dap->packet_buffer,
+			dap->packet_size - 1, &transferred, timeout_ms);
+	if (retval != LIBUSB_SUCCESS && retval != LIBUSB_ERROR_TIMEOUT) {
+		LOG_DEBUG("error reading data: %s", libusb_error_name(retval));
+		return -1;
+	}
+
+	return transferred;
+}
+
+static int cmsis_dap_usb_bulk_write(struct cmsis_dap *dap, int txlen)
+{
+	int transferred = 0;
+
+	/* no report number on bulk endpoints */
+	int retval = libusb_bulk_transfer(dap->usb_handle, dap->ep_out, dap->packet_buffer + 1,
+			txlen - 1, &transferred, USB_TIMEOUT);
+	if (retval != LIBUSB_SUCCESS || transferred != txlen - 1) {
+		LOG_ERROR("error writing data: %s", libusb_error_name(retval));
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static const struct cmsis_dap_backend cmsis_dap_usb_bulk_backend = {
+	.name = "usb_bulk",
+	.open = cmsis_dap_usb_bulk_open,
+	.close = cmsis_dap_usb_bulk_close,
+	.read = cmsis_dap_usb_bulk_read,
+	.write = cmsis_dap_usb_bulk_write,
+	.max_pending = MAX_PENDING_REQUESTS,
+};
+#endif
+
+/* CMSIS-DAP v2 (bulk) is preferred, it is faster than v1 (HID) */
+static const struct cmsis_dap_backend *const cmsis_dap_backends[] = {
+#ifdef HAVE_LIBUSB1
+	&cmsis_dap_usb_bulk_backend,
+#endif
+	&cmsis_dap_hid_backend,
+	NULL,
+};
+
+static int cmsis_dap_usb_open(void)
+{
+	struct cmsis_dap *dap = calloc(1, sizeof(struct cmsis_dap));
+	if (dap == NULL) {
+		LOG_ERROR("unable to allocate memory");
+		return ERROR_FAIL;
+	}
+
+	for (int i = 0; cmsis_dap_backends[i]; i++) {
+		if (cmsis_dap_backend_name && strcmp(cmsis_dap_backend_name, cmsis_dap_backends[i]->name))
+			continue;
+
+		if (cmsis_dap_backends[i]->open(dap) == ERROR_OK) {
+			dap->backend = cmsis_dap_backends[i];
+			break;
+		}
+	}
+
+	if (dap->backend == NULL) {
+		LOG_ERROR("unable to find CMSIS-DAP device");
+		free(dap);
+		return ERROR_FAIL;
+	}
+
+	cmsis_dap_handle = dap;
+
+	cmsis_dap_handle->packet_buffer = malloc(dap->packet_size);
 	if (cmsis_dap_handle->packet_buffer == NULL) {
 		LOG_ERROR("unable to allocate memory");
 		return ERROR_FAIL;
@@ -351,14 +634,15 @@ static int cmsis_dap_usb_open(void)
 
 static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 {
-	hid_close(dap->dev_handle);
-	hid_exit();
+	dap->backend->close(dap);
 
 	free(cmsis_dap_handle->packet_buffer);
 	free(cmsis_dap_handle);
 	cmsis_dap_handle = NULL;
 	free(cmsis_dap_serial);
 	cmsis_dap_serial = NULL;
+	free(cmsis_dap_backend_name);
+	cmsis_dap_backend_name = NULL;
 
 	for (int i = 0; i < MAX_PENDING_REQUESTS; i++) {
 		free(pending_fifo[i].transfers);
@@ -373,17 +657,7 @@ static int cmsis_dap_usb_write(struct cmsis_dap *dap, int txlen)
 #ifdef CMSIS_DAP_JTAG_DEBUG
 	LOG_DEBUG("cmsis-dap usb xfer cmd=%02X", dap->packet_buffer[1]);
 #endif
-	/* Pad the rest of the TX buffer with 0's */
-	memset(dap->packet_buffer + txlen, 0, dap->packet_size - txlen);
-
-	/* write data to device */
-	int retval = hid_write(dap->dev_handle, dap->packet_buffer, dap->packet_size);
-	if (retval == -1) {
-		LOG_ERROR("error writing data: %ls", hid_error(dap->dev_handle));
-		return ERROR_FAIL;
-	}
-
-	return ERROR_OK;
+	return dap->backend->write(dap, txlen);
 }
 
 /* Send a message and receive the reply */
@@ -392,7 +666,7 @@ static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
 	if (pending_fifo_block_count) {
 		LOG_ERROR("pending %d blocks, flushing", pending_fifo_block_count);
 		while (pending_fifo_block_count) {
-			hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, 10);
+			dap->backend->read(dap, 10);
 			pending_fifo_block_count--;
 		}
 		pending_fifo_put_idx = 0;
@@ -404,9 +678,9 @@ static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
 		return retval;
 
 	/* get reply */
-	retval = hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, USB_TIMEOUT);
+	retval = dap->backend->read(dap, USB_TIMEOUT);
 	if (retval == -1 || retval == 0) {
-		LOG_DEBUG("error reading data: %ls", hid_error(dap->dev_handle));
+		LOG_DEBUG("error reading data");
 		return ERROR_FAIL;
 	}
 
@@ -646,8 +920,27 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 
 	size_t idx = 0;
 	buffer[idx++] = 0;	/* report number */
-	buffer[idx++] = CMD_DAP_TFER;
+	buffer[idx++] = block->command;
 	buffer[idx++] = 0x00;	/* DAP Index */
+
+	if (block->command == CMD_DAP_TFER_BLOCK) {
+		/* one request for all transfers, only the data of writes follows */
+		uint8_t cmd = block->transfers[0].cmd;
+
+		LOG_DEBUG_IO("AP %s block reg %x, %d transfers",
+				cmd & SWD_CMD_RnW ? "read" : "write",
+				(cmd & SWD_CMD_A32) >> 1, block->transfer_count);
+
+		h_u16_to_le(&buffer[idx], block->transfer_count);
+		idx += 2;
+		buffer[idx++] = (cmd >> 1) & 0x0f;
+		for (int i = 0; i < block->transfer_count && !(cmd & SWD_CMD_RnW); i++) {
+			h_u32_to_le(&buffer[idx], block->transfers[i].data);
+			idx += 4;
+		}
+		goto write;
+	}
+
 	buffer[idx++] = block->transfer_count;
 
 	for (int i = 0; i < block->transfer_count; i++) {
@@ -688,6 +981,7 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 		}
 	}
 
+write:
 	queued_retval = cmsis_dap_usb_write(dap, idx);
 	if (queued_retval != ERROR_OK)
 		goto skip;
@@ -700,6 +994,7 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 	return;
 
 skip:
+	block->command = CMD_DAP_TFER;
 	block->transfer_count = 0;
 }
 
@@ -707,41 +1002,54 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
 {
 	uint8_t *buffer = dap->packet_buffer;
 	struct pending_request_block *block = &pending_fifo[pending_fifo_get_idx];
+	int count;
+	uint8_t response;
+	size_t idx;
 
 	if (pending_fifo_block_count == 0)
 		LOG_ERROR("no pending write");
 
 	/* get reply */
-	int retval = hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, timeout_ms);
+	int retval = dap->backend->read(dap, timeout_ms);
 	if (retval == 0 && timeout_ms < USB_TIMEOUT)
 		return;
 
 	if (retval == -1 || retval == 0) {
-		LOG_DEBUG("error reading data: %ls", hid_error(dap->dev_handle));
+		LOG_DEBUG("error reading data");
 		queued_retval = ERROR_FAIL;
 		goto skip;
 	}
 
-	if (buffer[2] & 0x08) {
-		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", buffer[1]);
+	/* DAP_TransferBlock has a 16-bit transfer count */
+	if (block->command == CMD_DAP_TFER_BLOCK) {
+		count = le_to_h_u16(&buffer[1]);
+		response = buffer[3];
+		idx = 4;
+	} else {
+		count = buffer[1];
+		response = buffer[2];
+		idx = 3;
+	}
+
+	if (response & 0x08) {
+		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", count);
 		queued_retval = ERROR_FAIL;
 		goto skip;
 	}
-	uint8_t ack = buffer[2] & 0x07;
+	uint8_t ack = response & 0x07;
 	if (ack != SWD_ACK_OK) {
-		LOG_DEBUG("SWD ack not OK @ %d %s", buffer[1],
+		LOG_DEBUG("SWD ack not OK @ %d %s", count,
 			  ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
 		queued_retval = ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
 		goto skip;
 	}
 
-	if (block->transfer_count != buffer[1])
+	if (block->transfer_count != count)
 		LOG_ERROR("CMSIS-DAP transfer count mismatch: expected %d, got %d",
-			  block->transfer_count, buffer[1]);
+			  block->transfer_count, count);
 
-	LOG_DEBUG_IO("Received results of %d queued transactions FIFO index %d", buffer[1], pending_fifo_get_idx);
-	size_t idx = 3;
-	for (int i = 0; i < buffer[1]; i++) {
+	LOG_DEBUG_IO("Received results of %d queued transactions FIFO index %d", count, pending_fifo_get_idx);
+	for (int i = 0; i < count; i++) {
 		struct pending_transfer_result *transfer = &(block->transfers[i]);
 		if (transfer->cmd & SWD_CMD_RnW) {
 			static uint32_t last_read;
@@ -764,6 +1072,7 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
 	}
 
 skip:
+	block->command = CMD_DAP_TFER;
 	block->transfer_count = 0;
 	pending_fifo_get_idx = (pending_fifo_get_idx + 1) % dap->packet_count;
 	pending_fifo_block_count--;
@@ -788,24 +1097,61 @@ static int cmsis_dap_swd_run_queue(void)
 	return retval;
 }
 
+static void cmsis_dap_swd_send_block(void)
+{
+	if (pending_fifo_block_count)
+		cmsis_dap_swd_read_process(cmsis_dap_handle, 0);
+
+	cmsis_dap_swd_write_from_queue(cmsis_dap_handle);
+
+	if (pending_fifo_block_count >= cmsis_dap_handle->packet_count)
+		cmsis_dap_swd_read_process(cmsis_dap_handle, USB_TIMEOUT);
+}
+
 static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 {
-	if (pending_fifo[pending_fifo_put_idx].transfer_count == pending_queue_len) {
-		if (pending_fifo_block_count)
-			cmsis_dap_swd_read_process(cmsis_dap_handle, 0);
+	struct pending_request_block *block = &pending_fifo[pending_fifo_put_idx];
+	struct pending_transfer_result *transfer;
 
-		/* Not enough room in the queue. Run the queue. */
-		cmsis_dap_swd_write_from_queue(cmsis_dap_handle);
+	if (block->command == CMD_DAP_TFER_BLOCK) {
+		bool run = cmd == block->transfers[0].cmd;
 
-		if (pending_fifo_block_count >= cmsis_dap_handle->packet_count)
-			cmsis_dap_swd_read_process(cmsis_dap_handle, USB_TIMEOUT);
+		/* The run of accesses ends, or there is no room left */
+		if (!run || block->transfer_count == pending_block_len) {
+			cmsis_dap_swd_send_block();
+
+			/* a run longer than a packet goes on in the next one */
+			if (run && queued_retval == ERROR_OK)
+				pending_fifo[pending_fifo_put_idx].command = CMD_DAP_TFER_BLOCK;
+		}
+	} else if (block->transfer_count && (cmd & SWD_CMD_APnDP)
+			&& block->transfers[block->transfer_count - 1].cmd == cmd) {
+		/* A second access to the same AP register, e.g. MEM-AP DRW in a
+		 * memory transfer: send what comes before, then continue with
+		 * DAP_TransferBlock which needs no request byte per transfer and
+		 * fits more transfers in a packet. */
+		struct pending_transfer_result first = block->transfers[--block->transfer_count];
+
+		if (block->transfer_count)
+			cmsis_dap_swd_send_block();
+
+		if (queued_retval != ERROR_OK)
+			return;
+
+		block = &pending_fifo[pending_fifo_put_idx];
+		block->command = CMD_DAP_TFER_BLOCK;
+		block->transfers[0] = first;
+		block->transfer_count = 1;
+	} else if (block->transfer_count == pending_queue_len) {
+		/* Not enough room in the queue. Run the queue. */
+		cmsis_dap_swd_send_block();
 	}
 
 	if (queued_retval != ERROR_OK)
 		return;
 
-	struct pending_request_block *block = &pending_fifo[pending_fifo_put_idx];
-	struct pending_transfer_result *transfer = &(block->transfers[block->transfer_count]);
+	block = &pending_fifo[pending_fifo_put_idx];
+	transfer = &(block->transfers[block->transfer_count]);
 	transfer->data = data;
 	transfer->cmd = cmd;
 	if (cmd & SWD_CMD_RnW) {
@@ -1011,6 +1357,7 @@ static int cmsis_dap_init(void)
 	 * until we get packet count info from the adaptor */
 	cmsis_dap_handle->packet_count = 1;
 	pending_queue_len = 12;
+	pending_block_len = (cmsis_dap_handle->packet_size - 1 - 5) / 4;
 
 	/* INFO_ID_PKT_SZ - short */
 	retval = cmsis_dap_cmd_DAP_Info(INFO_ID_PKT_SZ, &data);
@@ -1025,6 +1372,11 @@ static int cmsis_dap_init(void)
 		 * needed per transfer, so this is suboptimal. */
 		pending_queue_len = (pkt_sz - 4) / 5;
 
+		/* 5 bytes of command header + 4 bytes per register
+		 * access. Reads need a byte less for the header of
+		 * the response. */
+		pending_block_len = (pkt_sz - 5) / 4;
+
 		if (cmsis_dap_handle->packet_size != pkt_sz + 1) {
 			/* reallocate buffer */
 			cmsis_dap_handle->packet_size = pkt_sz + 1;
@@ -1047,14 +1399,16 @@ static int cmsis_dap_init(void)
 	if (data[0] == 1) { /* byte */
 		int pkt_cnt = data[1];
 		if (pkt_cnt > 1)
-			cmsis_dap_handle->packet_count = MIN(MAX_PENDING_REQUESTS, pkt_cnt);
+			cmsis_dap_handle->packet_count = MIN(cmsis_dap_handle->backend->max_pending, pkt_cnt);
 
 		LOG_DEBUG("CMSIS-DAP: Packet Count = %d", pkt_cnt);
 	}
 
-	LOG_DEBUG("Allocating FIFO for %d pending HID requests", cmsis_dap_handle->packet_count);
+	LOG_DEBUG("Allocating FIFO for %d pending requests", cmsis_dap_handle->packet_count);
 	for (int i = 0; i < cmsis_dap_handle->packet_count; i++) {
-		pending_fifo[i].transfers = malloc(pending_queue_len * sizeof(struct pending_transfer_result));
+		pending_fifo[i].command = CMD_DAP_TFER;
+		pending_fifo[i].transfers = malloc(MAX(pending_queue_len, pending_block_len)
+				* sizeof(struct pending_transfer_result));
 		if (!pending_fifo[i].transfers) {
 			LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
 			return ERROR_FAIL;
@@ -1745,6 +2099,29 @@ COMMAND_HANDLER(cmsis_dap_handle_serial_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cmsis_dap_handle_backend_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (strcmp(CMD_ARGV[0], "auto") == 0) {
+		free(cmsis_dap_backend_name);
+		cmsis_dap_backend_name = NULL;
+		return ERROR_OK;
+	}
+
+	for (int i = 0; cmsis_dap_backends[i]; i++) {
+		if (strcmp(CMD_ARGV[0], cmsis_dap_backends[i]->name) == 0) {
+			free(cmsis_dap_backend_name);
+			cmsis_dap_backend_name = strdup(CMD_ARGV[0]);
+			return ERROR_OK;
+		}
+	}
+
+	LOG_ERROR("invalid backend '%s' (not supported or not built in)", CMD_ARGV[0]);
+	return ERROR_COMMAND_SYNTAX_ERROR;
+}
+
 static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 	{
 		.name = "info",
@@ -1785,6 +2162,13 @@ static const struct command_registration cmsis_dap_command_handlers[] = {
 		.help = "set the serial number of the adapter",
 		.usage = "serial_string",
 	},
+	{
+		.name = "cmsis_dap_backend",
+		.handler = &cmsis_dap_handle_backend_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the communication backend of the adapter",
+		.usage = "auto | usb_bulk | hid",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
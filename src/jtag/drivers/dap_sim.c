@@ -0,0 +1,502 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+/**
+ * @file
+ * In-process model of an SWD debug port with a single MEM-AP (AP 0) in
+ * front of RAM regions configured with dap_sim_memory. It answers the
+ * transactions of the ADIv5 layer like a target would: posted AP reads,
+ * TAR auto-increment within 1 KiB, packed transfers, banked data
+ * registers, sticky errors for accesses outside of the memory map.
+ *
+ * The number of WAIT responses per AP access and a delay per queue run
+ * can be configured to approximate real adapters when measuring the
+ * upper layers.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <jtag/interface.h>
+#include <jtag/swd.h>
+
+#define DAP_SIM_DPIDR	0x2BA01477	/* ARM SW-DPv1 */
+#define DAP_SIM_AP_IDR	0x24770011	/* AHB-AP */
+
+struct dap_sim_memory {
+	uint32_t address;
+	uint32_t size;
+	uint8_t *data;
+	struct dap_sim_memory *next;
+};
+
+static struct dap_sim_memory *dap_sim_memories;
+
+/* DP and MEM-AP state */
+static uint32_t dap_sim_ctrl_stat;
+static uint32_t dap_sim_select;
+static uint32_t dap_sim_rdbuff;
+static uint32_t dap_sim_csw;
+static uint32_t dap_sim_tar;
+
+/* configuration */
+static unsigned dap_sim_wait_count;
+static unsigned dap_sim_latency_us;
+
+/* statistics */
+static unsigned long long dap_sim_transactions;
+static unsigned long long dap_sim_waits;
+static unsigned long long dap_sim_faults;
+static unsigned long long dap_sim_runs;
+static unsigned long long dap_sim_bytes;
+
+static int queued_retval;
+
+static uint8_t *dap_sim_find(uint32_t address, uint32_t size)
+{
+	for (struct dap_sim_memory *m = dap_sim_memories; m; m = m->next) {
+		if (address >= m->address && address - m->address + size <= m->size)
+			return m->data + (address - m->address);
+	}
+	return NULL;
+}
+
+/* Access n bytes at address through the byte lanes of the 32-bit data bus */
+static bool dap_sim_access(uint32_t address, unsigned n, bool write, uint32_t *data)
+{
+	uint8_t *p = dap_sim_find(address, n);
+	unsigned lane = address & 3;
+
+	if (!p)
+		return false;
+
+	if (write) {
+		for (unsigned i = 0; i < n; i++)
+			p[i] = *data >> (8 * (lane + i));
+	} else {
+		*data = 0;
+		for (unsigned i = 0; i < n; i++)
+			*data |= (uint32_t)p[i] << (8 * (lane + i));
+	}
+
+	dap_sim_bytes += n;
+	return true;
+}
+
+static void dap_sim_drw(bool write, uint32_t *data)
+{
+	unsigned size_sel = dap_sim_csw & CSW_SIZE_MASK;
+	unsigned size = size_sel <= CSW_32BIT ? 1u << size_sel : 4;
+	uint32_t inc = dap_sim_csw & CSW_ADDRINC_MASK;
+	uint32_t address = dap_sim_tar & ~(size - 1);
+	unsigned count = 1;
+	unsigned n = size;
+	uint32_t value = 0;
+
+	/* a packed access does 4 / size transfers, each one on the byte
+	 * lanes of its own address, and always moves TAR by 4 */
+	if (inc == CSW_ADDRINC_PACKED && size < 4) {
+		count = 4 / size;
+		n = 4;
+	}
+
+	for (unsigned i = 0; i < count; i++) {
+		uint32_t lanes = *data;
+
+		if (!dap_sim_access(address + i * size, size, write, &lanes)) {
+			LOG_DEBUG("dap_sim: %s of %u bytes at 0x%08" PRIx32 " outside of memory",
+				write ? "write" : "read", size, address + i * size);
+			dap_sim_ctrl_stat |= SSTICKYERR;
+			break;
+		}
+		value |= lanes;
+	}
+
+	if (!write)
+		*data = value;
+
+	if (inc != CSW_ADDRINC_OFF)
+		dap_sim_tar = (dap_sim_tar & ~0x3FFu) | ((address + n) & 0x3FF);
+}
+
+static uint32_t dap_sim_ap_read(unsigned reg)
+{
+	uint32_t value = 0;
+
+	/* only AP 0 exists, reading the others returns zero */
+	if (dap_sim_select & DP_SELECT_APSEL)
+		return 0;
+
+	switch (reg) {
+	case MEM_AP_REG_CSW:
+		value = dap_sim_csw;
+		break;
+	case MEM_AP_REG_TAR:
+		value = dap_sim_tar;
+		break;
+	case MEM_AP_REG_DRW:
+		dap_sim_drw(false, &value);
+		break;
+	case MEM_AP_REG_BD0:
+	case MEM_AP_REG_BD1:
+	case MEM_AP_REG_BD2:
+	case MEM_AP_REG_BD3:
+		if (!dap_sim_access((dap_sim_tar & ~0xFu) | (reg & 0xC), 4, false, &value))
+			dap_sim_ctrl_stat |= SSTICKYERR;
+		break;
+	case MEM_AP_REG_BASE:
+		/* legacy format, no debug entries */
+		value = 0xFFFFFFFF;
+		break;
+	case AP_REG_IDR:
+		value = DAP_SIM_AP_IDR;
+		break;
+	}
+
+	return value;
+}
+
+static void dap_sim_ap_write(unsigned reg, uint32_t value)
+{
+	if (dap_sim_select & DP_SELECT_APSEL)
+		return;
+
+	switch (reg) {
+	case MEM_AP_REG_CSW:
+		dap_sim_csw = value;
+		break;
+	case MEM_AP_REG_TAR:
+		dap_sim_tar = value;
+		break;
+	case MEM_AP_REG_DRW:
+		dap_sim_drw(true, &value);
+		break;
+	case MEM_AP_REG_BD0:
+	case MEM_AP_REG_BD1:
+	case MEM_AP_REG_BD2:
+	case MEM_AP_REG_BD3:
+		if (!dap_sim_access((dap_sim_tar & ~0xFu) | (reg & 0xC), 4, true, &value))
+			dap_sim_ctrl_stat |= SSTICKYERR;
+		break;
+	}
+}
+
+/* Returns false and records a FAULT if an AP access is refused. WAIT
+ * responses are retried by the adapter, so they are only counted. */
+static bool dap_sim_ap_ack(void)
+{
+	dap_sim_waits += dap_sim_wait_count;
+
+	if (dap_sim_ctrl_stat & SSTICKYERR) {
+		dap_sim_faults++;
+		queued_retval = SWD_ACK_FAULT;
+		return false;
+	}
+
+	return true;
+}
+
+static int dap_sim_swd_init(void)
+{
+	return ERROR_OK;
+}
+
+static int_least32_t dap_sim_frequency(int_least32_t hz)
+{
+	return hz;
+}
+
+static int dap_sim_switch_seq(enum swd_special_seq seq)
+{
+	return ERROR_OK;
+}
+
+static void dap_sim_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_hint)
+{
+	unsigned reg = (cmd & SWD_CMD_A32) >> 1;
+	uint32_t data = 0;
+
+	assert(cmd & SWD_CMD_RnW);
+
+	if (queued_retval != ERROR_OK)
+		return;
+
+	dap_sim_transactions++;
+
+	if (cmd & SWD_CMD_APnDP) {
+		if (!dap_sim_ap_ack())
+			return;
+		/* AP reads are posted, the result arrives with the next read */
+		data = dap_sim_rdbuff;
+		dap_sim_rdbuff = dap_sim_ap_read((dap_sim_select & DP_SELECT_APBANK) | reg);
+	} else {
+		switch (reg) {
+		case 0x0:
+			data = DAP_SIM_DPIDR;
+			break;
+		case 0x4:
+			/* power up requests are acknowledged immediately */
+			data = dap_sim_ctrl_stat
+				| ((dap_sim_ctrl_stat & CDBGPWRUPREQ) << 1)
+				| ((dap_sim_ctrl_stat & CSYSPWRUPREQ) << 1);
+			break;
+		case 0x8:
+		case 0xC:
+			data = dap_sim_rdbuff;
+			break;
+		}
+	}
+
+	if (value)
+		*value = data;
+}
+
+static void dap_sim_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_hint)
+{
+	unsigned reg = (cmd & SWD_CMD_A32) >> 1;
+
+	assert(!(cmd & SWD_CMD_RnW));
+
+	if (queued_retval != ERROR_OK)
+		return;
+
+	dap_sim_transactions++;
+
+	if (cmd & SWD_CMD_APnDP) {
+		if (dap_sim_ap_ack())
+			dap_sim_ap_write((dap_sim_select & DP_SELECT_APBANK) | reg, value);
+		return;
+	}
+
+	switch (reg) {
+	case 0x0:
+		if (value & STKERRCLR)
+			dap_sim_ctrl_stat &= ~SSTICKYERR;
+		break;
+	case 0x4:
+		/* sticky bits are cleared through ABORT only */
+		dap_sim_ctrl_stat = (value & ~SSTICKYERR) | (dap_sim_ctrl_stat & SSTICKYERR);
+		break;
+	case 0x8:
+		dap_sim_select = value;
+		break;
+	}
+}
+
+static int dap_sim_run(void)
+{
+	dap_sim_runs++;
+
+	if (dap_sim_latency_us)
+		jtag_sleep(dap_sim_latency_us);
+
+	int retval = queued_retval;
+	queued_retval = ERROR_OK;
+	return retval;
+}
+
+static const struct swd_driver dap_sim_swd = {
+	.init = dap_sim_swd_init,
+	.frequency = dap_sim_frequency,
+	.switch_seq = dap_sim_switch_seq,
+	.read_reg = dap_sim_read_reg,
+	.write_reg = dap_sim_write_reg,
+	.run = dap_sim_run,
+};
+
+static int dap_sim_execute_queue(void)
+{
+	/* there is nothing to reset */
+	return ERROR_OK;
+}
+
+static int dap_sim_speed(int speed)
+{
+	return ERROR_OK;
+}
+
+static int dap_sim_khz(int khz, int *jtag_speed)
+{
+	*jtag_speed = khz;
+	return ERROR_OK;
+}
+
+static int dap_sim_speed_div(int speed, int *khz)
+{
+	*khz = speed;
+	return ERROR_OK;
+}
+
+static int dap_sim_init(void)
+{
+	if (!dap_sim_memories)
+		LOG_WARNING("dap_sim: no memory configured, see dap_sim_memory");
+
+	dap_sim_ctrl_stat = 0;
+	dap_sim_select = 0;
+	dap_sim_rdbuff = 0;
+	dap_sim_csw = 0;
+	dap_sim_tar = 0;
+
+	return ERROR_OK;
+}
+
+static int dap_sim_quit(void)
+{
+	struct dap_sim_memory *m = dap_sim_memories;
+
+	while (m) {
+		struct dap_sim_memory *next = m->next;
+		free(m->data);
+		free(m);
+		m = next;
+	}
+	dap_sim_memories = NULL;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(dap_sim_handle_memory_command)
+{
+	uint32_t address, size;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+
+	if (size == 0 || address + (uint64_t)size > 0x100000000ULL) {
+		command_print(CMD_CTX, "invalid memory region");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct dap_sim_memory *m = calloc(1, sizeof(*m));
+	if (m)
+		m->data = calloc(1, size);
+	if (!m || !m->data) {
+		free(m);
+		LOG_ERROR("out of memory");
+		return ERROR_FAIL;
+	}
+
+	m->address = address;
+	m->size = size;
+	m->next = dap_sim_memories;
+	dap_sim_memories = m;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(dap_sim_handle_wait_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], dap_sim_wait_count);
+
+	command_print(CMD_CTX, "dap_sim: %u WAIT responses per AP access", dap_sim_wait_count);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(dap_sim_handle_latency_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], dap_sim_latency_us);
+
+	command_print(CMD_CTX, "dap_sim: %u us per queue run", dap_sim_latency_us);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(dap_sim_handle_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		dap_sim_transactions = 0;
+		dap_sim_waits = 0;
+		dap_sim_faults = 0;
+		dap_sim_runs = 0;
+		dap_sim_bytes = 0;
+		return ERROR_OK;
+	}
+
+	command_print(CMD_CTX, "transactions: %llu", dap_sim_transactions);
+	command_print(CMD_CTX, "queue runs:   %llu", dap_sim_runs);
+	command_print(CMD_CTX, "WAIT:         %llu", dap_sim_waits);
+	command_print(CMD_CTX, "FAULT:        %llu", dap_sim_faults);
+	command_print(CMD_CTX, "memory bytes: %llu", dap_sim_bytes);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration dap_sim_command_handlers[] = {
+	{
+		.name = "dap_sim_memory",
+		.handler = dap_sim_handle_memory_command,
+		.mode = COMMAND_CONFIG,
+		.help = "add a RAM region to the simulated memory map",
+		.usage = "address size",
+	},
+	{
+		.name = "dap_sim_wait",
+		.handler = dap_sim_handle_wait_command,
+		.mode = COMMAND_ANY,
+		.help = "set the number of WAIT responses per AP access",
+		.usage = "[count]",
+	},
+	{
+		.name = "dap_sim_latency",
+		.handler = dap_sim_handle_latency_command,
+		.mode = COMMAND_ANY,
+		.help = "set the delay of each queue run in microseconds",
+		.usage = "[us]",
+	},
+	{
+		.name = "dap_sim_stats",
+		.handler = dap_sim_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show or reset the transaction counters",
+		.usage = "[reset]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const char * const dap_sim_transports[] = { "swd", NULL };
+
+struct jtag_interface dap_sim_interface = {
+	.name = "dap_sim",
+	.commands = dap_sim_command_handlers,
+	.transports = dap_sim_transports,
+	.swd = &dap_sim_swd,
+
+	.execute_queue = dap_sim_execute_queue,
+	.speed = dap_sim_speed,
+	.khz = dap_sim_khz,
+	.speed_div = dap_sim_speed_div,
+
+	.init = dap_sim_init,
+	.quit = dap_sim_quit,
+};
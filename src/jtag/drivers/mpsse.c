@@ -64,6 +64,33 @@
 #define SIO_RESET_PURGE_RX 1
 #define SIO_RESET_PURGE_TX 2
 
+struct mpsse_ctx;
+struct mpsse_batch;
+
+/* Context needed by the callbacks */
+struct transfer_result {
+	struct mpsse_ctx *ctx;
+	struct mpsse_batch *batch;
+	bool done;
+	unsigned transferred;
+};
+
+/* Commands submitted to the device while the next ones are being queued. When no
+ * transfer is pending, the buffers are the idle half of the double buffer. */
+struct mpsse_batch {
+	bool pending;
+	int retval;
+	uint8_t *write_buffer;
+	unsigned write_count;
+	uint8_t *read_buffer;
+	unsigned read_count;
+	struct bit_copy_queue read_queue;
+	struct libusb_transfer *write_transfer;
+	struct libusb_transfer *read_transfer;
+	struct transfer_result write_result;
+	struct transfer_result read_result;
+};
+
 struct mpsse_ctx {
 	libusb_context *usb_ctx;
 	libusb_device_handle *usb_dev;
@@ -84,9 +111,13 @@ struct mpsse_ctx {
 	uint8_t *read_chunk;
 	unsigned read_chunk_size;
 	struct bit_copy_queue read_queue;
+	struct mpsse_batch batch;
 	int retval;
 };
 
+static int mpsse_wait(struct mpsse_ctx *ctx);
+static int mpsse_flush_buffer(struct mpsse_ctx *ctx);
+
 /* Returns true if the string descriptor indexed by str_index in device matches string */
 static bool string_descriptor_equal(libusb_device_handle *device, uint8_t str_index,
 	const char *string)
@@ -330,19 +361,23 @@ struct mpsse_ctx *mpsse_open(const uint16_t *vid, const uint16_t *pid, const cha
 		return 0;
 
 	bit_copy_queue_init(&ctx->read_queue);
+	bit_copy_queue_init(&ctx->batch.read_queue);
 	ctx->read_chunk_size = 16384;
 	ctx->read_size = 16384;
 	ctx->write_size = 16384;
 	ctx->read_chunk = malloc(ctx->read_chunk_size);
 	ctx->read_buffer = malloc(ctx->read_size);
+	ctx->batch.read_buffer = malloc(ctx->read_size);
 
 	/* Use calloc to make valgrind happy: buffer_write() sets payload
 	 * on bit basis, so some bits can be left uninitialized in write_buffer.
 	 * Although this is perfectly ok with MPSSE, valgrind reports
 	 * Syscall param ioctl(USBDEVFS_SUBMITURB).buffer points to uninitialised byte(s) */
 	ctx->write_buffer = calloc(1, ctx->write_size);
+	ctx->batch.write_buffer = calloc(1, ctx->write_size);
 
-	if (!ctx->read_chunk || !ctx->read_buffer || !ctx->write_buffer)
+	if (!ctx->read_chunk || !ctx->read_buffer || !ctx->write_buffer
+			|| !ctx->batch.read_buffer || !ctx->batch.write_buffer)
 		goto error;
 
 	ctx->interface = channel;
@@ -402,15 +437,22 @@ error:
 
 void mpsse_close(struct mpsse_ctx *ctx)
 {
+	if (ctx->batch.pending)
+		mpsse_wait(ctx);
 	if (ctx->usb_dev)
 		libusb_close(ctx->usb_dev);
 	if (ctx->usb_ctx)
 		libusb_exit(ctx->usb_ctx);
 	bit_copy_discard(&ctx->read_queue);
+	bit_copy_discard(&ctx->batch.read_queue);
 	if (ctx->write_buffer)
 		free(ctx->write_buffer);
 	if (ctx->read_buffer)
 		free(ctx->read_buffer);
+	if (ctx->batch.write_buffer)
+		free(ctx->batch.write_buffer);
+	if (ctx->batch.read_buffer)
+		free(ctx->batch.read_buffer);
 	if (ctx->read_chunk)
 		free(ctx->read_chunk);
 
@@ -517,7 +559,7 @@ void mpsse_clock_data(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_of
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) + (length < 8) < (out || (!out && !in) ? 4 : 3)
 				|| (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+			ctx->retval = mpsse_flush_buffer(ctx);
 
 		if (length < 8) {
 			/* Transfer remaining bits in bit mode */
@@ -591,7 +633,7 @@ void mpsse_clock_tms_cs(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_
 	while (length > 0) {
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) < 3 || (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+			ctx->retval = mpsse_flush_buffer(ctx);
 
 		/* Byte transfer */
 		unsigned this_bits = length;
@@ -634,7 +676,7 @@ void mpsse_set_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t d
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx);
 
 	buffer_write_byte(ctx, 0x80);
 	buffer_write_byte(ctx, data);
@@ -651,7 +693,7 @@ void mpsse_set_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx);
 
 	buffer_write_byte(ctx, 0x82);
 	buffer_write_byte(ctx, data);
@@ -668,7 +710,7 @@ void mpsse_read_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t *data)
 	}
 
 	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx);
 
 	buffer_write_byte(ctx, 0x81);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -684,7 +726,7 @@ void mpsse_read_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t *data)
 	}
 
 	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx);
 
 	buffer_write_byte(ctx, 0x83);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -699,7 +741,7 @@ static void single_byte_boolean_helper(struct mpsse_ctx *ctx, bool var, uint8_t
 	}
 
 	if (buffer_write_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx);
 
 	buffer_write_byte(ctx, var ? val_if_true : val_if_false);
 }
@@ -720,7 +762,7 @@ void mpsse_set_divisor(struct mpsse_ctx *ctx, uint16_t divisor)
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx);
 
 	buffer_write_byte(ctx, 0x86);
 	buffer_write_byte(ctx, divisor & 0xff);
@@ -780,17 +822,11 @@ int mpsse_set_frequency(struct mpsse_ctx *ctx, int frequency)
 	return frequency;
 }
 
-/* Context needed by the callbacks */
-struct transfer_result {
-	struct mpsse_ctx *ctx;
-	bool done;
-	unsigned transferred;
-};
-
 static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
 {
 	struct transfer_result *res = transfer->user_data;
 	struct mpsse_ctx *ctx = res->ctx;
+	struct mpsse_batch *batch = res->batch;
 
 	unsigned packet_size = ctx->max_packet_size;
 
@@ -804,21 +840,21 @@ static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
 		unsigned this_size = packet_size - 2;
 		if (this_size > chunk_remains - 2)
 			this_size = chunk_remains - 2;
-		if (this_size > ctx->read_count - res->transferred)
-			this_size = ctx->read_count - res->transferred;
-		memcpy(ctx->read_buffer + res->transferred,
+		if (this_size > batch->read_count - res->transferred)
+			this_size = batch->read_count - res->transferred;
+		memcpy(batch->read_buffer + res->transferred,
 			ctx->read_chunk + packet_size * i + 2,
 			this_size);
 		res->transferred += this_size;
 		chunk_remains -= this_size + 2;
-		if (res->transferred == ctx->read_count) {
+		if (res->transferred == batch->read_count) {
 			res->done = true;
 			break;
 		}
 	}
 
 	DEBUG_IO("raw chunk %d, transferred %d of %d", transfer->actual_length, res->transferred,
-		ctx->read_count);
+		batch->read_count);
 
 	if (!res->done)
 		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
@@ -828,71 +864,99 @@ static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
 static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer)
 {
 	struct transfer_result *res = transfer->user_data;
-	struct mpsse_ctx *ctx = res->ctx;
+	struct mpsse_batch *batch = res->batch;
 
 	res->transferred += transfer->actual_length;
 
-	DEBUG_IO("transferred %d of %d", res->transferred, ctx->write_count);
+	DEBUG_IO("transferred %d of %d", res->transferred, batch->write_count);
 
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
-	if (res->transferred == ctx->write_count)
+	if (res->transferred == batch->write_count)
 		res->done = true;
 	else {
-		transfer->length = ctx->write_count - res->transferred;
-		transfer->buffer = ctx->write_buffer + res->transferred;
+		transfer->length = batch->write_count - res->transferred;
+		transfer->buffer = batch->write_buffer + res->transferred;
 		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
 			res->done = true;
 	}
 }
 
-int mpsse_flush(struct mpsse_ctx *ctx)
+/* Hand the queued commands over to the batch and submit them to the device. The
+ * idle buffers of the batch become the new queue buffers, so queueing can go on
+ * while the transfers are in flight. Errors are reported by mpsse_wait(). */
+static void mpsse_submit(struct mpsse_ctx *ctx)
 {
-	int retval = ctx->retval;
-
-	if (retval != ERROR_OK) {
-		DEBUG_IO("Ignoring flush due to previous error");
-		assert(ctx->write_count == 0 && ctx->read_count == 0);
-		ctx->retval = ERROR_OK;
-		return retval;
-	}
+	struct mpsse_batch *batch = &ctx->batch;
+	uint8_t *buffer;
+	int retval;
 
-	DEBUG_IO("write %d%s, read %d", ctx->write_count, ctx->read_count ? "+1" : "",
-			ctx->read_count);
+	assert(!batch->pending);
 	assert(ctx->write_count > 0 || ctx->read_count == 0); /* No read data without write data */
 
-	if (ctx->write_count == 0)
-		return retval;
-
-	struct libusb_transfer *read_transfer = 0;
-	struct transfer_result read_result = { .ctx = ctx, .done = true };
 	if (ctx->read_count) {
 		buffer_write_byte(ctx, 0x87); /* SEND_IMMEDIATE */
-		read_result.done = false;
 		/* delay read transaction to ensure the FTDI chip can support us with data
 		   immediately after processing the MPSSE commands in the write transaction */
 	}
 
-	struct transfer_result write_result = { .ctx = ctx, .done = false };
-	struct libusb_transfer *write_transfer = libusb_alloc_transfer(0);
-	libusb_fill_bulk_transfer(write_transfer, ctx->usb_dev, ctx->out_ep, ctx->write_buffer,
-		ctx->write_count, write_cb, &write_result, ctx->usb_write_timeout);
-	retval = libusb_submit_transfer(write_transfer);
-	if (retval != LIBUSB_SUCCESS)
-		goto error_check;
+	buffer = batch->write_buffer;
+	batch->write_buffer = ctx->write_buffer;
+	batch->write_count = ctx->write_count;
+	ctx->write_buffer = buffer;
+	ctx->write_count = 0;
 
-	if (ctx->read_count) {
-		read_transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(read_transfer, ctx->usb_dev, ctx->in_ep, ctx->read_chunk,
-			ctx->read_chunk_size, read_cb, &read_result,
+	buffer = batch->read_buffer;
+	batch->read_buffer = ctx->read_buffer;
+	batch->read_count = ctx->read_count;
+	ctx->read_buffer = buffer;
+	ctx->read_count = 0;
+
+	list_splice_init(&ctx->read_queue.list, &batch->read_queue.list);
+
+	batch->pending = true;
+	batch->retval = LIBUSB_SUCCESS;
+	batch->write_result = (struct transfer_result) { .ctx = ctx, .batch = batch, .done = false };
+	batch->read_result = (struct transfer_result) { .ctx = ctx, .batch = batch,
+		.done = batch->read_count == 0 };
+	batch->read_transfer = NULL;
+
+	batch->write_transfer = libusb_alloc_transfer(0);
+	libusb_fill_bulk_transfer(batch->write_transfer, ctx->usb_dev, ctx->out_ep,
+		batch->write_buffer, batch->write_count, write_cb, &batch->write_result,
+		ctx->usb_write_timeout);
+	retval = libusb_submit_transfer(batch->write_transfer);
+	if (retval != LIBUSB_SUCCESS) {
+		batch->write_result.done = true;
+		batch->read_result.done = true;
+		batch->retval = retval;
+		return;
+	}
+
+	if (batch->read_count) {
+		batch->read_transfer = libusb_alloc_transfer(0);
+		libusb_fill_bulk_transfer(batch->read_transfer, ctx->usb_dev, ctx->in_ep,
+			ctx->read_chunk, ctx->read_chunk_size, read_cb, &batch->read_result,
 			ctx->usb_read_timeout);
-		retval = libusb_submit_transfer(read_transfer);
-		if (retval != LIBUSB_SUCCESS)
-			goto error_check;
+		retval = libusb_submit_transfer(batch->read_transfer);
+		if (retval != LIBUSB_SUCCESS) {
+			batch->read_result.done = true;
+			batch->retval = retval;
+		}
 	}
+}
+
+/* Wait for the submitted batch, if any, and copy its read data to the callers' buffers */
+static int mpsse_wait(struct mpsse_ctx *ctx)
+{
+	struct mpsse_batch *batch = &ctx->batch;
+	int retval = batch->retval;
+
+	if (!batch->pending)
+		return ERROR_OK;
 
 	/* Polling loop, more or less taken from libftdi */
-	while (!write_result.done || !read_result.done) {
+	while (!batch->write_result.done || !batch->read_result.done) {
 		struct timeval timeout_usb;
 
 		timeout_usb.tv_sec = 1;
@@ -904,10 +968,10 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 			break;
 
 		if (retval != LIBUSB_SUCCESS) {
-			libusb_cancel_transfer(write_transfer);
-			if (read_transfer)
-				libusb_cancel_transfer(read_transfer);
-			while (!write_result.done || !read_result.done) {
+			libusb_cancel_transfer(batch->write_transfer);
+			if (batch->read_transfer)
+				libusb_cancel_transfer(batch->read_transfer);
+			while (!batch->write_result.done || !batch->read_result.done) {
 				retval = libusb_handle_events_timeout_completed(ctx->usb_ctx,
 								&timeout_usb, NULL);
 				if (retval != LIBUSB_SUCCESS)
@@ -916,37 +980,87 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 		}
 	}
 
-error_check:
+	if (retval == LIBUSB_SUCCESS)
+		retval = batch->retval;
+
 	if (retval != LIBUSB_SUCCESS) {
 		LOG_ERROR("libusb_handle_events() failed with %s", libusb_error_name(retval));
 		retval = ERROR_FAIL;
-	} else if (write_result.transferred < ctx->write_count) {
+	} else if (batch->write_result.transferred < batch->write_count) {
 		LOG_ERROR("ftdi device did not accept all data: %d, tried %d",
-			write_result.transferred,
-			ctx->write_count);
+			batch->write_result.transferred,
+			batch->write_count);
 		retval = ERROR_FAIL;
-	} else if (read_result.transferred < ctx->read_count) {
+	} else if (batch->read_result.transferred < batch->read_count) {
 		LOG_ERROR("ftdi device did not return all data: %d, expected %d",
-			read_result.transferred,
-			ctx->read_count);
+			batch->read_result.transferred,
+			batch->read_count);
 		retval = ERROR_FAIL;
-	} else if (ctx->read_count) {
-		ctx->write_count = 0;
-		ctx->read_count = 0;
-		bit_copy_execute(&ctx->read_queue);
-		retval = ERROR_OK;
 	} else {
-		ctx->write_count = 0;
-		bit_copy_discard(&ctx->read_queue);
 		retval = ERROR_OK;
 	}
 
-	libusb_free_transfer(write_transfer);
-	if (read_transfer)
-		libusb_free_transfer(read_transfer);
+	if (retval == ERROR_OK && batch->read_count)
+		bit_copy_execute(&batch->read_queue);
+	else
+		bit_copy_discard(&batch->read_queue);
+
+	libusb_free_transfer(batch->write_transfer);
+	if (batch->read_transfer)
+		libusb_free_transfer(batch->read_transfer);
+	batch->write_transfer = NULL;
+	batch->read_transfer = NULL;
+	batch->write_count = 0;
+	batch->read_count = 0;
+	batch->retval = LIBUSB_SUCCESS;
+	batch->pending = false;
 
 	if (retval != ERROR_OK)
 		mpsse_purge(ctx);
 
 	return retval;
 }
+
+/* Make room in the queue buffers when they run full. The queued commands are
+ * submitted without waiting for their completion, so the transfer overlaps with
+ * queueing the next commands; only the previous batch is waited for. */
+static int mpsse_flush_buffer(struct mpsse_ctx *ctx)
+{
+	int retval = ctx->retval;
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = mpsse_wait(ctx);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (ctx->write_count)
+		mpsse_submit(ctx);
+
+	return ERROR_OK;
+}
+
+int mpsse_flush(struct mpsse_ctx *ctx)
+{
+	int retval = ctx->retval;
+
+	if (retval != ERROR_OK) {
+		DEBUG_IO("Ignoring flush due to previous error");
+		assert(ctx->write_count == 0 && ctx->read_count == 0 && !ctx->batch.pending);
+		ctx->retval = ERROR_OK;
+		return retval;
+	}
+
+	DEBUG_IO("write %d%s, read %d", ctx->write_count, ctx->read_count ? "+1" : "",
+			ctx->read_count);
+	assert(ctx->write_count > 0 || ctx->read_count == 0); /* No read data without write data */
+
+	retval = mpsse_wait(ctx);
+	if (retval != ERROR_OK || ctx->write_count == 0)
+		return retval;
+
+	mpsse_submit(ctx);
+
+	return mpsse_wait(ctx);
+}
@@ -2253,6 +2253,115 @@ static uint32_t stlink_max_block_size(uint32_t tar_autoincr_block, uint32_t addr
 	return max_tar_block;
 }
 
+#ifdef USE_LIBUSB_ASYNCIO
+/* Number of memory chunks whose USB transfers are submitted together */
+#define STLINK_MEM_PIPELINE_DEPTH 4
+
+/** Command and status buffers of one pipelined memory chunk */
+struct stlink_mem_chunk {
+	uint8_t cmd[STLINK_CMD_SIZE_V2];
+	uint8_t status_cmd[STLINK_CMD_SIZE_V2];
+	uint8_t status[12];
+	uint32_t len;
+};
+
+/** ST-Link/V1 wraps commands in mass storage requests and has no R/W status */
+static bool stlink_usb_can_pipeline(void *handle)
+{
+	struct stlink_usb_handle_s *h = handle;
+
+	return h->transport != HL_TRANSPORT_SWIM && h->version.stlink != 1
+		&& h->version.jtag_api != STLINK_JTAG_API_V1;
+}
+
+/**
+ * Reads or writes 16 or 32 bit memory in up to STLINK_MEM_PIPELINE_DEPTH
+ * chunks with a single USB submission. The memory command, data phase and
+ * R/W status query of every chunk are all queued at once, so the adapter
+ * finds its next command waiting as soon as a data phase ends, instead of
+ * a round trip per phase.
+ *
+ * @a addr must be aligned to @a size and @a count a multiple of it. The
+ * number of bytes in the chunks completed without error is stored in
+ * @a done, to resume from there on ERROR_WAIT.
+ */
+static int stlink_usb_rw_mem_pipelined(void *handle, bool write, uint32_t addr,
+		uint32_t size, uint32_t count, uint8_t *buffer, uint32_t *done)
+{
+	struct stlink_usb_handle_s *h = handle;
+	struct stlink_mem_chunk chunks[STLINK_MEM_PIPELINE_DEPTH];
+	struct jtag_xfer transfers[4 * STLINK_MEM_PIPELINE_DEPTH];
+	size_t n_chunks = 0, n_transfers = 0;
+	size_t status_size = 2;
+	uint8_t status_cmd = STLINK_DEBUG_APIV2_GETLASTRWSTATUS;
+	uint8_t opcode;
+	uint32_t offset = 0;
+	int retval;
+
+	*done = 0;
+
+	if (h->version.flags & STLINK_F_HAS_GETLASTRWSTATUS2) {
+		status_size = 12;
+		status_cmd = STLINK_DEBUG_APIV2_GETLASTRWSTATUS2;
+	}
+
+	if (size == 2)
+		opcode = write ? STLINK_DEBUG_APIV2_WRITEMEM_16BIT : STLINK_DEBUG_APIV2_READMEM_16BIT;
+	else
+		opcode = write ? STLINK_DEBUG_WRITEMEM_32BIT : STLINK_DEBUG_READMEM_32BIT;
+
+	memset(chunks, 0, sizeof(chunks));
+	memset(transfers, 0, sizeof(transfers));
+
+	while (offset < count && n_chunks < STLINK_MEM_PIPELINE_DEPTH) {
+		struct stlink_mem_chunk *chunk = &chunks[n_chunks++];
+
+		chunk->len = MIN(count - offset, stlink_max_block_size(h->max_mem_packet, addr + offset));
+
+		chunk->cmd[0] = STLINK_DEBUG_COMMAND;
+		chunk->cmd[1] = opcode;
+		h_u32_to_le(chunk->cmd + 2, addr + offset);
+		h_u16_to_le(chunk->cmd + 6, chunk->len);
+
+		chunk->status_cmd[0] = STLINK_DEBUG_COMMAND;
+		chunk->status_cmd[1] = status_cmd;
+
+		transfers[n_transfers].ep = h->tx_ep;
+		transfers[n_transfers].buf = chunk->cmd;
+		transfers[n_transfers++].size = sizeof(chunk->cmd);
+
+		/* the data goes straight to or from the caller's buffer */
+		transfers[n_transfers].ep = write ? h->tx_ep : h->rx_ep;
+		transfers[n_transfers].buf = buffer + offset;
+		transfers[n_transfers++].size = chunk->len;
+
+		transfers[n_transfers].ep = h->tx_ep;
+		transfers[n_transfers].buf = chunk->status_cmd;
+		transfers[n_transfers++].size = sizeof(chunk->status_cmd);
+
+		transfers[n_transfers].ep = h->rx_ep;
+		transfers[n_transfers].buf = chunk->status;
+		transfers[n_transfers++].size = status_size;
+
+		offset += chunk->len;
+	}
+
+	retval = jtag_libusb_bulk_transfer_n(h->fd, transfers, n_transfers, STLINK_WRITE_TIMEOUT);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (size_t i = 0; i < n_chunks; i++) {
+		memcpy(h->databuf, chunks[i].status, status_size);
+		retval = stlink_usb_error_check(handle);
+		if (retval != ERROR_OK)
+			return retval;
+		*done += chunks[i].len;
+	}
+
+	return ERROR_OK;
+}
+#endif
+
 static int stlink_usb_read_mem(void *handle, uint32_t addr, uint32_t size,
 		uint32_t count, uint8_t *buffer)
 {
@@ -2314,6 +2423,25 @@ static int stlink_usb_read_mem(void *handle, uint32_t addr, uint32_t size,
 				bytes_remaining -= head_bytes;
 			}
 
+#ifdef USE_LIBUSB_ASYNCIO
+			if (stlink_usb_can_pipeline(handle) && count >= size) {
+				uint32_t done;
+
+				retval = stlink_usb_rw_mem_pipelined(handle, false, addr, size,
+						count & ~(size - 1), buffer, &done);
+				buffer += done;
+				addr += done;
+				count -= done;
+				if (retval == ERROR_WAIT && retries < MAX_WAIT_RETRIES) {
+					usleep((1<<retries++) * 1000);
+					continue;
+				}
+				if (retval != ERROR_OK)
+					return retval;
+				continue;
+			}
+#endif
+
 			if (bytes_remaining & (size - 1))
 				retval = stlink_usb_read_mem(handle, addr, 1, bytes_remaining, buffer);
 			else if (size == 2)
@@ -2399,6 +2527,25 @@ static int stlink_usb_write_mem(void *handle, uint32_t addr, uint32_t size,
 				bytes_remaining -= head_bytes;
 			}
 
+#ifdef USE_LIBUSB_ASYNCIO
+			if (stlink_usb_can_pipeline(handle) && count >= size) {
+				uint32_t done;
+
+				retval = stlink_usb_rw_mem_pipelined(handle, true, addr, size,
+						count & ~(size - 1), (uint8_t *)buffer, &done);
+				buffer += done;
+				addr += done;
+				count -= done;
+				if (retval == ERROR_WAIT && retries < MAX_WAIT_RETRIES) {
+					usleep((1<<retries++) * 1000);
+					continue;
+				}
+				if (retval != ERROR_OK)
+					return retval;
+				continue;
+			}
+#endif
+
 			if (bytes_remaining & (size - 1))
 				retval = stlink_usb_write_mem(handle, addr, 1, bytes_remaining, buffer);
 			else if (size == 2)
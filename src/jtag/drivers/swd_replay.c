@@ -0,0 +1,255 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+/**
+ * @file
+ * SWD interface driver answering from a trace recorded with
+ * swd_trace_record. Every transaction queued by the upper layers has to
+ * match the next one in the trace; read values and run results are taken
+ * from the trace. Once the two diverge all further runs fail.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <jtag/interface.h>
+#include <jtag/swd.h>
+
+static char *swd_replay_filename;
+static FILE *swd_replay_file;
+static bool swd_replay_diverged;
+static unsigned long swd_replay_count;
+
+static const char *swd_replay_record_name(int type)
+{
+	switch (type) {
+	case SWD_TRACE_READ:
+		return "read";
+	case SWD_TRACE_WRITE:
+		return "write";
+	case SWD_TRACE_SEQ:
+		return "sequence";
+	case SWD_TRACE_RUN:
+		return "run";
+	case EOF:
+		return "end of trace";
+	default:
+		return "invalid record";
+	}
+}
+
+static void swd_replay_diverge(const char *what, int type)
+{
+	if (!swd_replay_diverged)
+		LOG_ERROR("SWD trace diverged at transaction %lu: %s queued, trace has %s",
+			swd_replay_count, what, swd_replay_record_name(type));
+	swd_replay_diverged = true;
+}
+
+/* Read the next record of the expected type, false if the trace diverged */
+static bool swd_replay_next(int expected, uint8_t *payload, size_t size)
+{
+	if (swd_replay_diverged)
+		return false;
+
+	int type = fgetc(swd_replay_file);
+	if (type != expected) {
+		swd_replay_diverge(swd_replay_record_name(expected), type);
+		return false;
+	}
+
+	if (fread(payload, 1, size, swd_replay_file) != size) {
+		swd_replay_diverge(swd_replay_record_name(expected), EOF);
+		return false;
+	}
+
+	swd_replay_count++;
+	return true;
+}
+
+static int swd_replay_swd_init(void)
+{
+	return ERROR_OK;
+}
+
+static int_least32_t swd_replay_frequency(int_least32_t hz)
+{
+	return hz;
+}
+
+static int swd_replay_switch_seq(enum swd_special_seq seq)
+{
+	uint8_t payload[1];
+
+	if (swd_replay_next(SWD_TRACE_SEQ, payload, sizeof(payload)) && payload[0] != seq)
+		swd_replay_diverge("sequence", SWD_TRACE_SEQ);
+
+	return ERROR_OK;
+}
+
+static void swd_replay_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_hint)
+{
+	uint8_t payload[5];
+
+	if (!swd_replay_next(SWD_TRACE_READ, payload, sizeof(payload)))
+		return;
+
+	if (payload[0] != cmd) {
+		swd_replay_diverge("read", SWD_TRACE_READ);
+		return;
+	}
+
+	if (value)
+		*value = le_to_h_u32(payload + 1);
+}
+
+static void swd_replay_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_hint)
+{
+	uint8_t payload[5];
+
+	if (!swd_replay_next(SWD_TRACE_WRITE, payload, sizeof(payload)))
+		return;
+
+	if (payload[0] != cmd || le_to_h_u32(payload + 1) != value) {
+		LOG_DEBUG("write 0x%02" PRIx8 " 0x%08" PRIx32 ", trace has 0x%02" PRIx8 " 0x%08" PRIx32,
+			cmd, value, payload[0], le_to_h_u32(payload + 1));
+		swd_replay_diverge("write", SWD_TRACE_WRITE);
+	}
+}
+
+static int swd_replay_run(void)
+{
+	uint8_t payload[4];
+
+	if (!swd_replay_next(SWD_TRACE_RUN, payload, sizeof(payload)))
+		return ERROR_FAIL;
+
+	return (int32_t)le_to_h_u32(payload);
+}
+
+static const struct swd_driver swd_replay_swd = {
+	.init = swd_replay_swd_init,
+	.frequency = swd_replay_frequency,
+	.switch_seq = swd_replay_switch_seq,
+	.read_reg = swd_replay_read_reg,
+	.write_reg = swd_replay_write_reg,
+	.run = swd_replay_run,
+};
+
+static int swd_replay_execute_queue(void)
+{
+	/* JTAG commands (e.g. reset) have no effect on a replayed target */
+	return ERROR_OK;
+}
+
+static int swd_replay_speed(int speed)
+{
+	return ERROR_OK;
+}
+
+static int swd_replay_khz(int khz, int *jtag_speed)
+{
+	*jtag_speed = khz;
+	return ERROR_OK;
+}
+
+static int swd_replay_speed_div(int speed, int *khz)
+{
+	*khz = speed;
+	return ERROR_OK;
+}
+
+static int swd_replay_init(void)
+{
+	char magic[SWD_TRACE_MAGIC_SIZE];
+
+	if (!swd_replay_filename) {
+		LOG_ERROR("no SWD trace file given, use swd_replay_file");
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	swd_replay_file = fopen(swd_replay_filename, "rb");
+	if (!swd_replay_file) {
+		LOG_ERROR("can't open SWD trace file '%s'", swd_replay_filename);
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	if (fread(magic, 1, sizeof(magic), swd_replay_file) != sizeof(magic)
+			|| memcmp(magic, SWD_TRACE_MAGIC, sizeof(magic))) {
+		LOG_ERROR("'%s' is not an SWD trace file", swd_replay_filename);
+		fclose(swd_replay_file);
+		swd_replay_file = NULL;
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	swd_replay_diverged = false;
+	swd_replay_count = 0;
+
+	return ERROR_OK;
+}
+
+static int swd_replay_quit(void)
+{
+	if (swd_replay_file) {
+		LOG_DEBUG("replayed %lu SWD transactions", swd_replay_count);
+		fclose(swd_replay_file);
+		swd_replay_file = NULL;
+	}
+
+	free(swd_replay_filename);
+	swd_replay_filename = NULL;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(swd_replay_handle_file_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	free(swd_replay_filename);
+	swd_replay_filename = strdup(CMD_ARGV[0]);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration swd_replay_command_handlers[] = {
+	{
+		.name = "swd_replay_file",
+		.handler = swd_replay_handle_file_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the SWD trace file to replay",
+		.usage = "filename",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const char * const swd_replay_transports[] = { "swd", NULL };
+
+struct jtag_interface swd_replay_interface = {
+	.name = "swd_replay",
+	.commands = swd_replay_command_handlers,
+	.transports = swd_replay_transports,
+	.swd = &swd_replay_swd,
+
+	.execute_queue = swd_replay_execute_queue,
+	.speed = swd_replay_speed,
+	.khz = swd_replay_khz,
+	.speed_div = swd_replay_speed_div,
+
+	.init = swd_replay_init,
+	.quit = swd_replay_quit,
+};
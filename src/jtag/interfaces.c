@@ -51,6 +51,12 @@ extern struct jtag_interface parport_interface;
 #if BUILD_DUMMY == 1
 extern struct jtag_interface dummy_interface;
 #endif
+#if BUILD_SWD_REPLAY == 1
+extern struct jtag_interface swd_replay_interface;
+#endif
+#if BUILD_DAP_SIM == 1
+extern struct jtag_interface dap_sim_interface;
+#endif
 #if BUILD_FTDI == 1
 extern struct jtag_interface ftdi_interface;
 #endif
@@ -156,6 +162,12 @@ struct jtag_interface *jtag_interfaces[] = {
 #if BUILD_DUMMY == 1
 		&dummy_interface,
 #endif
+#if BUILD_SWD_REPLAY == 1
+		&swd_replay_interface,
+#endif
+#if BUILD_DAP_SIM == 1
+		&dap_sim_interface,
+#endif
 #if BUILD_FTDI == 1
 		&ftdi_interface,
 #endif
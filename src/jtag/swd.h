@@ -305,4 +305,19 @@ struct swd_driver {
 int swd_init_reset(struct command_context *cmd_ctx);
 void swd_add_reset(int req_srst);
 
+/* SWD transaction trace, see swd_trace.c for the file format */
+#define SWD_TRACE_MAGIC "OCDSWDT1"
+#define SWD_TRACE_MAGIC_SIZE 8
+
+enum swd_trace_record {
+	SWD_TRACE_READ = 'R',
+	SWD_TRACE_WRITE = 'W',
+	SWD_TRACE_SEQ = 'S',
+	SWD_TRACE_RUN = 'X',
+};
+
+const struct swd_driver *swd_trace_driver(const struct swd_driver *swd);
+void swd_trace_close(void);
+int swd_trace_register_commands(struct command_context *ctx);
+
 #endif /* OPENOCD_JTAG_SWD_H */
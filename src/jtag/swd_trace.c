@@ -0,0 +1,221 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+/**
+ * @file
+ * Recording of SWD transactions. When enabled, the swd_driver of the
+ * adapter is wrapped so every queued register access, special sequence
+ * and the result of each run is appended to a trace file. The swd_replay
+ * interface driver plays such a file back without hardware.
+ *
+ * The file starts with SWD_TRACE_MAGIC, followed by records made of a
+ * type byte and a payload:
+ * - SWD_TRACE_READ, SWD_TRACE_WRITE: command byte, 32-bit value
+ * - SWD_TRACE_SEQ: enum swd_special_seq as a byte
+ * - SWD_TRACE_RUN: 32-bit return value of swd_driver.run()
+ *
+ * All 32-bit values are little endian. Read values are stored after the
+ * run that completed them.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "interface.h"
+#include "swd.h"
+
+struct swd_trace_op {
+	uint8_t type;
+	uint8_t cmd;
+	uint32_t value;
+	uint32_t *dst;
+};
+
+static char *swd_trace_filename;
+static FILE *swd_trace_file;
+static const struct swd_driver *swd_trace_adapter;
+static struct swd_driver swd_trace_swd;
+
+/* transactions queued since the last run */
+static struct swd_trace_op *swd_trace_ops;
+static size_t swd_trace_num_ops;
+static size_t swd_trace_max_ops;
+
+static void swd_trace_queue(uint8_t type, uint8_t cmd, uint32_t value, uint32_t *dst)
+{
+	if (swd_trace_num_ops == swd_trace_max_ops) {
+		size_t max_ops = swd_trace_max_ops ? 2 * swd_trace_max_ops : 64;
+		struct swd_trace_op *ops = realloc(swd_trace_ops, max_ops * sizeof(*ops));
+		if (!ops) {
+			LOG_ERROR("out of memory, SWD trace is incomplete");
+			return;
+		}
+		swd_trace_ops = ops;
+		swd_trace_max_ops = max_ops;
+	}
+
+	struct swd_trace_op *op = &swd_trace_ops[swd_trace_num_ops++];
+	op->type = type;
+	op->cmd = cmd;
+	op->value = value;
+	op->dst = dst;
+}
+
+static void swd_trace_write(uint8_t type, const uint8_t *payload, size_t size)
+{
+	if (!swd_trace_file)
+		return;
+
+	if (fputc(type, swd_trace_file) == EOF
+			|| fwrite(payload, 1, size, swd_trace_file) != size) {
+		LOG_ERROR("failed to write SWD trace '%s', recording stopped",
+			swd_trace_filename);
+		fclose(swd_trace_file);
+		swd_trace_file = NULL;
+	}
+}
+
+static int swd_trace_switch_seq(enum swd_special_seq seq)
+{
+	int retval = swd_trace_adapter->switch_seq(seq);
+	if (retval == ERROR_OK)
+		swd_trace_queue(SWD_TRACE_SEQ, seq, 0, NULL);
+	return retval;
+}
+
+static void swd_trace_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_hint)
+{
+	swd_trace_queue(SWD_TRACE_READ, cmd, 0, value);
+	swd_trace_adapter->read_reg(cmd, value, ap_delay_hint);
+}
+
+static void swd_trace_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_hint)
+{
+	swd_trace_queue(SWD_TRACE_WRITE, cmd, value, NULL);
+	swd_trace_adapter->write_reg(cmd, value, ap_delay_hint);
+}
+
+static int swd_trace_run(void)
+{
+	int retval = swd_trace_adapter->run();
+	uint8_t payload[5];
+
+	for (size_t i = 0; i < swd_trace_num_ops; i++) {
+		struct swd_trace_op *op = &swd_trace_ops[i];
+
+		if (op->type == SWD_TRACE_SEQ) {
+			payload[0] = op->cmd;
+			swd_trace_write(op->type, payload, 1);
+			continue;
+		}
+
+		if (op->type == SWD_TRACE_READ)
+			op->value = op->dst ? *op->dst : 0;
+		payload[0] = op->cmd;
+		h_u32_to_le(payload + 1, op->value);
+		swd_trace_write(op->type, payload, 5);
+	}
+	swd_trace_num_ops = 0;
+
+	h_u32_to_le(payload, retval);
+	swd_trace_write(SWD_TRACE_RUN, payload, 4);
+
+	return retval;
+}
+
+/**
+ * Returns the driver to use for SWD transactions: @a swd itself, or a
+ * wrapper recording all transactions if swd_trace_record is in effect.
+ */
+const struct swd_driver *swd_trace_driver(const struct swd_driver *swd)
+{
+	if (!swd || !swd_trace_filename)
+		return swd;
+
+	if (!swd_trace_file) {
+		swd_trace_file = fopen(swd_trace_filename, "wb");
+		if (!swd_trace_file) {
+			LOG_ERROR("can't open SWD trace file '%s'", swd_trace_filename);
+			return swd;
+		}
+		if (fwrite(SWD_TRACE_MAGIC, 1, SWD_TRACE_MAGIC_SIZE, swd_trace_file)
+				!= SWD_TRACE_MAGIC_SIZE) {
+			LOG_ERROR("failed to write SWD trace '%s'", swd_trace_filename);
+			fclose(swd_trace_file);
+			swd_trace_file = NULL;
+			return swd;
+		}
+		LOG_INFO("recording SWD transactions to '%s'", swd_trace_filename);
+	}
+
+	swd_trace_adapter = swd;
+	swd_trace_swd = *swd;
+	swd_trace_swd.switch_seq = swd_trace_switch_seq;
+	swd_trace_swd.read_reg = swd_trace_read_reg;
+	swd_trace_swd.write_reg = swd_trace_write_reg;
+	swd_trace_swd.run = swd_trace_run;
+
+	return &swd_trace_swd;
+}
+
+void swd_trace_close(void)
+{
+	if (swd_trace_file) {
+		fclose(swd_trace_file);
+		swd_trace_file = NULL;
+	}
+
+	free(swd_trace_ops);
+	swd_trace_ops = NULL;
+	swd_trace_num_ops = 0;
+	swd_trace_max_ops = 0;
+
+	free(swd_trace_filename);
+	swd_trace_filename = NULL;
+}
+
+COMMAND_HANDLER(handle_swd_trace_record_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		free(swd_trace_filename);
+		swd_trace_filename = strdup(CMD_ARGV[0]);
+	}
+
+	command_print(CMD_CTX, "SWD trace file: %s",
+		swd_trace_filename ? swd_trace_filename : "none");
+
+	return ERROR_OK;
+}
+
+static const struct command_registration swd_trace_command_handlers[] = {
+	{
+		.name = "swd_trace_record",
+		.handler = handle_swd_trace_record_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Record all SWD transactions to a file "
+			"that the swd_replay interface can play back.",
+		.usage = "[filename]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int swd_trace_register_commands(struct command_context *ctx)
+{
+	return register_commands(ctx, NULL, swd_trace_command_handlers);
+}
@@ -832,6 +832,23 @@ COMMAND_HANDLER(handle_jtag_init_command)
 	return jtag_init(CMD_CTX);
 }
 
+COMMAND_HANDLER(handle_jtag_queue_stats_command)
+{
+	struct cmd_queue_stats stats;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	cmd_queue_get_stats(&stats);
+
+	command_print(CMD_CTX, "pages in use: %u, high water: %u, pooled: %u",
+			stats.pages_in_use, stats.pages_high_water, stats.pages_pooled);
+	command_print(CMD_CTX, "pages allocated: %lu, oversize allocations: %lu",
+			stats.pages_allocated, stats.oversize_allocs);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_subcommand_handlers[] = {
 	{
 		.name = "init",
@@ -914,6 +931,13 @@ static const struct command_registration jtag_subcommand_handlers[] = {
 		.jim_handler = jim_jtag_names,
 		.help = "Returns list of all JTAG tap names.",
 	},
+	{
+		.name = "queue_stats",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_queue_stats_command,
+		.help = "Show allocation counters of the command queue memory.",
+		.usage = "",
+	},
 	{
 		.chain = jtag_command_handlers_to_move,
 	},
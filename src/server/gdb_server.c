@@ -48,6 +48,7 @@
 #include "gdb_server.h"
 #include <target/image.h>
 #include <jtag/jtag.h>
+#include <helper/time_support.h>
 #include "rtos/rtos.h"
 #include "target/smp.h"
 
@@ -60,9 +61,32 @@
  * found in most modern embedded processors.
  */
 
+/* target description generated for a target, kept until the layout of
+ * its register list changes, see gdb_get_target_description() */
 struct target_desc_format {
+	struct target *target;
+	uint32_t signature;
 	char *tdesc;
 	uint32_t tdesc_length;
+	struct target_desc_format *next;
+};
+
+/* memory cache geometry, see gdb_mem_cache_read() */
+#define GDB_MEM_CACHE_LINE_SIZE		64
+#define GDB_MEM_CACHE_LINES			256
+/* larger reads are not worth caching, GDB won't ask for them again */
+#define GDB_MEM_CACHE_MAX_READ		1024
+
+struct gdb_mem_cache_line {
+	bool valid;
+	target_addr_t address;
+	uint8_t data[GDB_MEM_CACHE_LINE_SIZE];
+};
+
+/* memory range excluded from caching, e.g. peripherals */
+struct gdb_mem_cache_exclude {
+	target_addr_t address;
+	uint32_t size;
 };
 
 /* private connection data for GDB */
@@ -73,6 +97,10 @@ struct gdb_connection {
 	int ctrl_c;
 	enum target_state frontend_state;
 	struct image *vflash_image;
+	/* addresses below this one were already programmed during vFlashWrite */
+	target_addr_t vflash_stream_limit;
+	uint32_t vflash_written;
+	bool vflash_write_started;
 	bool closed;
 	bool busy;
 	int noack_mode;
@@ -90,10 +118,41 @@ struct gdb_connection {
 	 * normally we reply with a S reply via gdb_last_signal_packet.
 	 * as a side note this behaviour only effects gdb > 6.8 */
 	bool attached;
-	/* temporarily used for target description support */
-	struct target_desc_format target_desc;
 	/* temporarily used for thread list support */
 	char *thread_list;
+	/* memory read buffers, reused across packets and grown on demand:
+	 * raw target data and the encoded reply built from it */
+	uint8_t *mem_buffer;
+	char *reply_buffer;
+	uint32_t mem_buffer_size;
+	/* incoming packet, gdb_packet_size bytes at connect time */
+	char *packet_buffer;
+	int packet_buffer_size;
+	/* block fetched ahead of sequential memory reads, see gdb_read_memory() */
+	uint8_t *read_ahead;
+	target_addr_t read_ahead_address;
+	uint32_t read_ahead_len;
+	uint32_t read_ahead_generation;
+	/* address following the last memory read, to detect sequential reads */
+	target_addr_t next_read_address;
+	bool next_read_valid;
+	/* memory read while the targets were stopped, valid as long as
+	 * target_get_generation() returns mem_cache_generation */
+	struct gdb_mem_cache_line *mem_cache;
+	uint32_t mem_cache_generation;
+	/* set by QNonStop:1, stops are then reported asynchronously with
+	 * %Stop notifications while GDB keeps talking to us */
+	bool non_stop;
+	/* the running target was stopped by a vCont;t action */
+	bool vcont_stop;
+	/* GDB uses pid qualified thread ids, the pid of a target is
+	 * its number + 1, see gdb_multiprocess_packet() */
+	bool multiprocess;
+	/* targets attached in multiprocess mode, indexed by target number */
+	bool *mp_attached;
+	int mp_attached_size;
+	/* target of the gdb service when the connection was made */
+	struct target *mp_origin;
 };
 
 #if 0
@@ -138,10 +197,34 @@ static int gdb_report_register_access_error;
  * via qXfer:features:read packet */
 /* enabled by default */
 static int gdb_use_target_description = 1;
+/* target descriptions of all targets GDB asked for */
+static struct target_desc_format *gdb_target_descs;
 
 /* current processing free-run type, used by file-I/O */
 static char gdb_running_type;
 
+/* maximum packet size advertised to gdb in qSupported */
+static unsigned int gdb_packet_size = GDB_BUFFER_SIZE;
+
+/* number of bytes read from the target at once when gdb reads memory
+ * sequentially, e.g. for a dump. Disabled (0) by default. */
+static unsigned int gdb_read_ahead_size;
+
+/* set if memory read by gdb is cached until a target resumes, steps,
+ * resets or has its memory written. Disabled by default. */
+static int gdb_use_memory_cache;
+/* ranges never served from the memory cache */
+static struct gdb_mem_cache_exclude *gdb_mem_cache_excludes;
+static unsigned int gdb_mem_cache_exclude_count;
+
+/* minimum amount of complete flash sectors received by vFlashWrite before
+ * they are programmed, without waiting for vFlashDone. Disabled (0) by default. */
+static unsigned int gdb_flash_stream_size;
+
+/* set if all targets are served on the port of the first one, GDB selects
+ * them as processes with its multiprocess extensions. Disabled by default. */
+static int gdb_multiprocess;
+
 static int gdb_last_signal(struct target *target)
 {
 	switch (target->debug_reason) {
@@ -221,8 +304,10 @@ static int gdb_get_char_inner(struct connection *connection, int *next_char)
 					GDB_BUFFER_SIZE);
 		}
 
-		if (gdb_con->buf_cnt > 0)
+		if (gdb_con->buf_cnt > 0) {
+			connection->stats.bytes_in += gdb_con->buf_cnt;
 			break;
+		}
 		if (gdb_con->buf_cnt == 0) {
 			gdb_con->closed = true;
 			return ERROR_SERVER_REMOTE_CLOSED;
@@ -490,6 +575,49 @@ int gdb_put_packet(struct connection *connection, char *buffer, int len)
 	return retval;
 }
 
+/* Send an asynchronous notification, e.g. "%Stop:T05". Notifications
+ * are not acknowledged by GDB. */
+static int gdb_put_notification(struct connection *connection,
+		const char *name, const char *buffer, int len)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	unsigned char my_checksum = 0;
+	int name_len = strlen(name);
+
+	char *notification = malloc(name_len + len + 5);
+	if (notification == NULL)
+		return ERROR_FAIL;
+
+	notification[0] = '%';
+	memcpy(notification + 1, name, name_len);
+	notification[1 + name_len] = ':';
+	memcpy(notification + 2 + name_len, buffer, len);
+
+	int pos = 2 + name_len + len;
+	for (int i = 1; i < pos; i++)
+		my_checksum += notification[i];
+	sprintf(notification + pos, "#%02x", my_checksum);
+
+	gdb_con->busy = true;
+	int retval = gdb_write(connection, notification, pos + 3);
+	gdb_con->busy = false;
+
+	free(notification);
+	return retval;
+}
+
+/* Report a stop to GDB: as reply to the pending resume packet in all-stop
+ * mode, as %Stop notification in non-stop mode. */
+static int gdb_put_stop_reply(struct connection *connection, char *reply, int len)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (gdb_con->non_stop)
+		return gdb_put_notification(connection, "Stop", reply, len);
+
+	return gdb_put_packet(connection, reply, len);
+}
+
 static inline int fetch_packet(struct connection *connection,
 		int *checksum_ok, int noack, int *len, char *buffer)
 {
@@ -721,12 +849,31 @@ static int gdb_output(struct command_context *context, const char *line)
 	return ERROR_OK;
 }
 
+/* Writes the "thread:<id>;" part of a stop reply for target to buf, or
+ * nothing if GDB doesn't need it. It is required in non-stop mode and
+ * with multiprocess ids, targets without an RTOS report thread 1. */
+static void gdb_stop_reply_thread(struct connection *connection, struct target *target,
+		char *buf, size_t size)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	int64_t tid = target->rtos != NULL ? target->rtos->current_thread : 1;
+
+	if (gdb_connection->multiprocess)
+		snprintf(buf, size, "thread:p%x.%" PRIx64 ";", target->target_number + 1, tid);
+	else if (target->rtos != NULL)
+		snprintf(buf, size, "thread:%016" PRIx64 ";", tid);
+	else if (gdb_connection->non_stop)
+		snprintf(buf, size, "thread:1;");
+	else
+		buf[0] = '\0';
+}
+
 static void gdb_signal_reply(struct target *target, struct connection *connection)
 {
 	struct gdb_connection *gdb_connection = connection->priv;
-	char sig_reply[45];
+	char sig_reply[64];
 	char stop_reason[20];
-	char current_thread[25];
+	char current_thread[40];
 	int sig_reply_len;
 	int signal_var;
 
@@ -735,7 +882,10 @@ static void gdb_signal_reply(struct target *target, struct connection *connectio
 	if (target->debug_reason == DBG_REASON_EXIT) {
 		sig_reply_len = snprintf(sig_reply, sizeof(sig_reply), "W00");
 	} else {
-		if (gdb_connection->ctrl_c) {
+		if (gdb_connection->vcont_stop) {
+			/* stops requested with vCont;t are reported as signal 0 */
+			signal_var = 0;
+		} else if (gdb_connection->ctrl_c) {
 			signal_var = 0x2;
 		} else
 			signal_var = gdb_last_signal(target);
@@ -766,14 +916,12 @@ static void gdb_signal_reply(struct target *target, struct connection *connectio
 			}
 		}
 
-		current_thread[0] = '\0';
+		gdb_stop_reply_thread(connection, target, current_thread, sizeof(current_thread));
 		if (target->rtos != NULL) {
 			struct target *ct;
-			snprintf(current_thread, sizeof(current_thread), "thread:%016" PRIx64 ";",
-					target->rtos->current_thread);
 			target->rtos->current_threadid = target->rtos->current_thread;
 			target->rtos->gdb_target_for_threadid(connection, target->rtos->current_threadid, &ct);
-			if (!gdb_connection->ctrl_c)
+			if (!gdb_connection->ctrl_c && !gdb_connection->vcont_stop)
 				signal_var = gdb_last_signal(ct);
 		}
 
@@ -781,9 +929,10 @@ static void gdb_signal_reply(struct target *target, struct connection *connectio
 				signal_var, stop_reason, current_thread);
 
 		gdb_connection->ctrl_c = 0;
+		gdb_connection->vcont_stop = false;
 	}
 
-	gdb_put_packet(connection, sig_reply, sig_reply_len);
+	gdb_put_stop_reply(connection, sig_reply, sig_reply_len);
 	gdb_connection->frontend_state = TARGET_HALTED;
 }
 
@@ -929,6 +1078,29 @@ static int gdb_target_callback_event_handler(struct target *target,
 	return ERROR_OK;
 }
 
+/* Make sure the memory read buffers can hold len bytes of target data and
+ * the longest possible reply for it, i.e. a one character prefix followed
+ * by len bytes that are all escaped or hex encoded. */
+static int gdb_reserve_mem_buffers(struct gdb_connection *gdb_con, uint32_t len)
+{
+	if (len <= gdb_con->mem_buffer_size)
+		return ERROR_OK;
+
+	uint8_t *mem_buffer = realloc(gdb_con->mem_buffer, len);
+	if (mem_buffer == NULL)
+		return ERROR_FAIL;
+	gdb_con->mem_buffer = mem_buffer;
+
+	char *reply_buffer = realloc(gdb_con->reply_buffer, len * 2 + 2);
+	if (reply_buffer == NULL)
+		return ERROR_FAIL;
+	gdb_con->reply_buffer = reply_buffer;
+
+	gdb_con->mem_buffer_size = len;
+
+	return ERROR_OK;
+}
+
 static int gdb_new_connection(struct connection *connection)
 {
 	struct gdb_connection *gdb_connection = malloc(sizeof(struct gdb_connection));
@@ -946,15 +1118,47 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->ctrl_c = 0;
 	gdb_connection->frontend_state = TARGET_HALTED;
 	gdb_connection->vflash_image = NULL;
+	gdb_connection->vflash_stream_limit = 0;
+	gdb_connection->vflash_written = 0;
+	gdb_connection->vflash_write_started = false;
 	gdb_connection->closed = false;
 	gdb_connection->busy = false;
 	gdb_connection->noack_mode = 0;
 	gdb_connection->sync = false;
 	gdb_connection->mem_write_error = false;
 	gdb_connection->attached = true;
-	gdb_connection->target_desc.tdesc = NULL;
-	gdb_connection->target_desc.tdesc_length = 0;
+	gdb_connection->non_stop = false;
+	gdb_connection->vcont_stop = false;
+	gdb_connection->multiprocess = false;
+	gdb_connection->mp_attached = NULL;
+	gdb_connection->mp_attached_size = 0;
+	gdb_connection->mp_origin = target;
 	gdb_connection->thread_list = NULL;
+	gdb_connection->mem_buffer = NULL;
+	gdb_connection->reply_buffer = NULL;
+	gdb_connection->mem_buffer_size = 0;
+	gdb_connection->packet_buffer_size = gdb_packet_size;
+	gdb_connection->packet_buffer = malloc(gdb_packet_size);
+	gdb_connection->read_ahead = NULL;
+	gdb_connection->read_ahead_address = 0;
+	gdb_connection->read_ahead_len = 0;
+	gdb_connection->read_ahead_generation = 0;
+	gdb_connection->next_read_address = 0;
+	gdb_connection->next_read_valid = false;
+	gdb_connection->mem_cache = NULL;
+	gdb_connection->mem_cache_generation = 0;
+
+	/* preallocate the memory read buffers for a full sized packet */
+	if (gdb_connection->packet_buffer == NULL ||
+			gdb_reserve_mem_buffers(gdb_connection, gdb_packet_size / 2) != ERROR_OK) {
+		LOG_ERROR("Unable to allocate memory for the GDB connection");
+		free(gdb_connection->packet_buffer);
+		free(gdb_connection->mem_buffer);
+		free(gdb_connection->reply_buffer);
+		free(gdb_connection);
+		connection->priv = NULL;
+		return ERROR_FAIL;
+	}
 
 	/* send ACK to GDB for debug request */
 	gdb_write(connection, "+", 1);
@@ -1029,6 +1233,28 @@ static int gdb_new_connection(struct connection *connection)
 	return ERROR_OK;
 }
 
+/* Drop the image built with vFlash commands and the streaming state, e.g.
+ * when a load was aborted without vFlashDone. The GDB_FLASH_WRITE_START
+ * event sent while streaming is completed with its END event. */
+static void gdb_vflash_reset(struct connection *connection)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+
+	if (gdb_connection->vflash_write_started)
+		target_call_event_callbacks(get_target_from_connection(connection),
+				TARGET_EVENT_GDB_FLASH_WRITE_END);
+
+	if (gdb_connection->vflash_image) {
+		image_close(gdb_connection->vflash_image);
+		free(gdb_connection->vflash_image);
+		gdb_connection->vflash_image = NULL;
+	}
+
+	gdb_connection->vflash_stream_limit = 0;
+	gdb_connection->vflash_written = 0;
+	gdb_connection->vflash_write_started = false;
+}
+
 static int gdb_connection_closed(struct connection *connection)
 {
 	struct target *target;
@@ -1048,15 +1274,33 @@ static int gdb_connection_closed(struct connection *connection)
 		gdb_actual_connections);
 
 	/* see if an image built with vFlash commands is left */
-	if (gdb_connection->vflash_image) {
-		image_close(gdb_connection->vflash_image);
-		free(gdb_connection->vflash_image);
-		gdb_connection->vflash_image = NULL;
-	}
+	gdb_vflash_reset(connection);
 
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
 
+	/* the other processes gdb was attached to are detached as well */
+	for (int i = 0; i < gdb_connection->mp_attached_size; i++) {
+		struct target *t = get_target_by_num(i);
+		if (gdb_connection->mp_attached[i] && t != NULL && t != target) {
+			target_call_event_callbacks(t, TARGET_EVENT_GDB_END);
+			target_call_event_callbacks(t, TARGET_EVENT_GDB_DETACH);
+		}
+	}
+	free(gdb_connection->mp_attached);
+
+	/* the next connection starts on the target owning the port again */
+	if (gdb_connection->multiprocess) {
+		struct gdb_service *gdb_service = connection->service->priv;
+		gdb_service->target = gdb_connection->mp_origin;
+	}
+
+	free(gdb_connection->mem_buffer);
+	free(gdb_connection->reply_buffer);
+	free(gdb_connection->packet_buffer);
+	free(gdb_connection->read_ahead);
+	free(gdb_connection->mem_cache);
+
 	if (connection->priv) {
 		free(connection->priv);
 		connection->priv = NULL;
@@ -1094,8 +1338,33 @@ static int gdb_last_signal_packet(struct connection *connection,
 		return ERROR_OK;
 	}
 
+	if (gdb_con->non_stop) {
+		/* report the stopped thread, if any, like a vStopped sequence */
+		if (target->state == TARGET_HALTED) {
+			char thread[40];
+			char reply[48];
+			gdb_stop_reply_thread(connection, target, thread, sizeof(thread));
+			int len = snprintf(reply, sizeof(reply), "T%2.2x%s",
+					gdb_last_signal(target), thread);
+			gdb_put_packet(connection, reply, len);
+		} else
+			gdb_put_packet(connection, "OK", 2);
+		return ERROR_OK;
+	}
+
 	signal_var = gdb_last_signal(target);
 
+	if (gdb_con->multiprocess) {
+		/* tell gdb which process and thread it is talking to */
+		char thread[40];
+		char mp_reply[48];
+		rtos_update_threads(target);
+		gdb_stop_reply_thread(connection, target, thread, sizeof(thread));
+		int len = snprintf(mp_reply, sizeof(mp_reply), "T%2.2x%s", signal_var, thread);
+		gdb_put_packet(connection, mp_reply, len);
+		return ERROR_OK;
+	}
+
 	snprintf(sig_reply, 4, "S%2.2x", signal_var);
 	gdb_put_packet(connection, sig_reply, 3);
 
@@ -1195,11 +1464,21 @@ static int gdb_get_registers_packet(struct connection *connection,
 
 	reg_packet_p = reg_packet;
 
+	/* let the target fetch the invalid registers in one batch, anything
+	 * it couldn't read is fetched one by one below */
+	int64_t start = timeval_us();
+	retval = target_read_registers(target, reg_list, reg_list_size);
+	connection->stats.target_time += timeval_us() - start;
+	if (retval != ERROR_OK)
+		LOG_DEBUG("batched register read failed (%d)", retval);
+
 	for (i = 0; i < reg_list_size; i++) {
 		if (reg_list[i] == NULL || reg_list[i]->exist == false)
 			continue;
 		if (!reg_list[i]->valid) {
+			start = timeval_us();
 			retval = reg_list[i]->type->get(reg_list[i]);
+			connection->stats.target_time += timeval_us() - start;
 			if (retval != ERROR_OK && gdb_report_register_access_error) {
 				LOG_DEBUG("Couldn't get register %s.", reg_list[i]->name);
 				free(reg_packet);
@@ -1317,7 +1596,9 @@ static int gdb_get_register_packet(struct connection *connection,
 	}
 
 	if (!reg_list[reg_num]->valid) {
+		int64_t start = timeval_us();
 		retval = reg_list[reg_num]->type->get(reg_list[reg_num]);
+		connection->stats.target_time += timeval_us() - start;
 		if (retval != ERROR_OK && gdb_report_register_access_error) {
 			LOG_DEBUG("Couldn't get register %s.", reg_list[reg_num]->name);
 			free(reg_list);
@@ -1405,21 +1686,215 @@ static int gdb_error(struct connection *connection, int retval)
 	return ERROR_OK;
 }
 
+/* Returns true if a read of len bytes at addr may be served from the
+ * memory cache. Drops cached data when a target has changed since it was
+ * read. */
+static bool gdb_mem_cache_usable(struct gdb_connection *gdb_con,
+		target_addr_t addr, uint32_t len)
+{
+	if (!gdb_use_memory_cache || len > GDB_MEM_CACHE_MAX_READ)
+		return false;
+
+	/* the cache reads whole lines, which must not touch an excluded range */
+	target_addr_t first = addr & ~(target_addr_t)(GDB_MEM_CACHE_LINE_SIZE - 1);
+	target_addr_t last = (addr + len - 1) | (GDB_MEM_CACHE_LINE_SIZE - 1);
+
+	for (unsigned int i = 0; i < gdb_mem_cache_exclude_count; i++) {
+		struct gdb_mem_cache_exclude *ex = &gdb_mem_cache_excludes[i];
+		if (first <= ex->address + ex->size - 1 && ex->address <= last)
+			return false;
+	}
+
+	/* a running core or algorithm can change memory at any time */
+	for (struct target *t = all_targets; t; t = t->next) {
+		if (t->state == TARGET_RUNNING || t->state == TARGET_DEBUG_RUNNING)
+			return false;
+	}
+
+	if (gdb_con->mem_cache == NULL) {
+		gdb_con->mem_cache = calloc(GDB_MEM_CACHE_LINES, sizeof(struct gdb_mem_cache_line));
+		if (gdb_con->mem_cache == NULL)
+			return false;
+		gdb_con->mem_cache_generation = target_get_generation();
+	}
+
+	if (gdb_con->mem_cache_generation != target_get_generation()) {
+		for (int i = 0; i < GDB_MEM_CACHE_LINES; i++)
+			gdb_con->mem_cache[i].valid = false;
+		gdb_con->mem_cache_generation = target_get_generation();
+	}
+
+	return true;
+}
+
+static struct gdb_mem_cache_line *gdb_mem_cache_line(struct gdb_connection *gdb_con,
+		target_addr_t line_address)
+{
+	return &gdb_con->mem_cache[(line_address / GDB_MEM_CACHE_LINE_SIZE) % GDB_MEM_CACHE_LINES];
+}
+
+/* Serve a memory read from the cache, filling missing lines from the
+ * target. Lines are aligned blocks of GDB_MEM_CACHE_LINE_SIZE bytes, so
+ * the stack words and code GDB reads again and again after each stop only
+ * cost one adapter round trip per line. */
+static int gdb_mem_cache_read(struct connection *connection,
+		target_addr_t addr, uint32_t len, uint8_t *buffer)
+{
+	struct target *target = get_target_from_connection(connection);
+	struct gdb_connection *gdb_con = connection->priv;
+
+	while (len > 0) {
+		target_addr_t line_address = addr & ~(target_addr_t)(GDB_MEM_CACHE_LINE_SIZE - 1);
+		struct gdb_mem_cache_line *line = gdb_mem_cache_line(gdb_con, line_address);
+
+		if (!line->valid || line->address != line_address) {
+			line->valid = false;
+			int retval = target_read_buffer(target, line_address,
+					GDB_MEM_CACHE_LINE_SIZE, line->data);
+			if (retval != ERROR_OK)
+				return retval;
+			line->address = line_address;
+			line->valid = true;
+		}
+
+		uint32_t offset = addr - line_address;
+		uint32_t n = MIN(len, GDB_MEM_CACHE_LINE_SIZE - offset);
+		memcpy(buffer, line->data + offset, n);
+
+		buffer += n;
+		addr += n;
+		len -= n;
+	}
+
+	return ERROR_OK;
+}
+
+/* Write through: update the cached lines with data GDB just wrote to the
+ * target. generation is the value of target_get_generation() before the
+ * write, if it still matches the cache the write was the only change. */
+static void gdb_mem_cache_write(struct gdb_connection *gdb_con, uint32_t generation,
+		target_addr_t addr, uint32_t len, const uint8_t *buffer)
+{
+	if (gdb_con->mem_cache == NULL || gdb_con->mem_cache_generation != generation)
+		return;
+
+	while (len > 0) {
+		target_addr_t line_address = addr & ~(target_addr_t)(GDB_MEM_CACHE_LINE_SIZE - 1);
+		struct gdb_mem_cache_line *line = gdb_mem_cache_line(gdb_con, line_address);
+		uint32_t offset = addr - line_address;
+		uint32_t n = MIN(len, GDB_MEM_CACHE_LINE_SIZE - offset);
+
+		if (line->valid && line->address == line_address)
+			memcpy(line->data + offset, buffer, n);
+
+		buffer += n;
+		addr += n;
+		len -= n;
+	}
+
+	gdb_con->mem_cache_generation = target_get_generation();
+}
+
+/* Read target memory for a memory read packet.
+ *
+ * GDB splits large reads, e.g. dumps, into packet sized requests that
+ * arrive one after the other. When such a sequential access is detected,
+ * gdb_read_ahead_size bytes are fetched with a single target_read_buffer()
+ * call and the following requests are served from that block, so the
+ * adapter sees few large transfers instead of many small round trips.
+ * The block is dropped as soon as any other packet is processed, and
+ * also when the target runs or has changed since it was read.
+ */
+static int gdb_read_memory(struct connection *connection,
+		target_addr_t addr, uint32_t len, uint8_t *buffer)
+{
+	struct target *target = get_target_from_connection(connection);
+	struct gdb_connection *gdb_con = connection->priv;
+	bool sequential = gdb_con->next_read_valid && addr == gdb_con->next_read_address;
+	bool halted = target->state == TARGET_HALTED;
+
+	gdb_con->next_read_address = addr + len;
+	gdb_con->next_read_valid = true;
+
+	if (!halted || gdb_con->read_ahead_generation != target_get_generation())
+		gdb_con->read_ahead_len = 0;
+
+	if (gdb_con->read_ahead_len && addr >= gdb_con->read_ahead_address &&
+			addr + len <= gdb_con->read_ahead_address + gdb_con->read_ahead_len) {
+		memcpy(buffer, gdb_con->read_ahead + (addr - gdb_con->read_ahead_address), len);
+		return ERROR_OK;
+	}
+
+	gdb_con->read_ahead_len = 0;
+
+	if (sequential && halted && gdb_read_ahead_size > len &&
+			addr + gdb_read_ahead_size - 1 <= target_address_max(target) &&
+			addr + gdb_read_ahead_size - 1 > addr) {
+		if (gdb_con->read_ahead == NULL) {
+			gdb_con->read_ahead = malloc(gdb_read_ahead_size);
+			if (gdb_con->read_ahead == NULL)
+				return target_read_buffer(target, addr, len, buffer);
+		}
+
+		int retval = target_read_buffer(target, addr, gdb_read_ahead_size,
+				gdb_con->read_ahead);
+		if (retval == ERROR_OK) {
+			gdb_con->read_ahead_address = addr;
+			gdb_con->read_ahead_len = gdb_read_ahead_size;
+			gdb_con->read_ahead_generation = target_get_generation();
+			memcpy(buffer, gdb_con->read_ahead, len);
+			return ERROR_OK;
+		}
+
+		/* the block may extend into memory that can't be read,
+		 * try again with just the requested range */
+		LOG_DEBUG("read ahead of %u bytes at 0x%16.16" PRIx64 " failed",
+				gdb_read_ahead_size, (uint64_t)addr);
+	}
+
+	if (gdb_mem_cache_usable(gdb_con, addr, len) &&
+			gdb_mem_cache_read(connection, addr, len, buffer) == ERROR_OK)
+		return ERROR_OK;
+
+	return target_read_buffer(target, addr, len, buffer);
+}
+
+/* Encode binary data as described in "Binary Data" of the GDB remote
+ * protocol documentation: '#', '$', '}' and '*' are sent as '}' followed
+ * by the original byte XOR 0x20. out must have room for 2 * len bytes.
+ *
+ * Returns the number of characters written to out.
+ */
+static size_t gdb_escape_binary(char *out, const uint8_t *in, size_t len)
+{
+	char *p = out;
+
+	for (size_t i = 0; i < len; i++) {
+		uint8_t c = in[i];
+		if (c == '#' || c == '$' || c == '}' || c == '*') {
+			*p++ = '}';
+			*p++ = c ^ 0x20;
+		} else
+			*p++ = c;
+	}
+
+	return p - out;
+}
+
 /* We don't have to worry about the default 2 second timeout for GDB packets,
  * because GDB breaks up large memory reads into smaller reads.
  *
- * 8191 bytes by the looks of it. Why 8191 bytes instead of 8192?????
+ * Handles both the hex encoded 'm' packet and the binary 'x' packet, which
+ * GDB uses instead when binary-upload is advertised in qSupported.
  */
 static int gdb_read_memory_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
-	struct target *target = get_target_from_connection(connection);
+	struct gdb_connection *gdb_con = connection->priv;
 	char *separator;
 	uint64_t addr = 0;
 	uint32_t len = 0;
-
-	uint8_t *buffer;
-	char *hex_buffer;
+	bool binary = packet[0] == 'x';
 
 	int retval = ERROR_OK;
 
@@ -1436,16 +1911,27 @@ static int gdb_read_memory_packet(struct connection *connection,
 	len = strtoul(separator + 1, NULL, 16);
 
 	if (!len) {
+		if (binary) {
+			/* zero length reads are used to probe for 'x' support */
+			gdb_put_packet(connection, "b", 1);
+			return ERROR_OK;
+		}
 		LOG_WARNING("invalid read memory packet received (len == 0)");
 		gdb_put_packet(connection, "", 0);
 		return ERROR_OK;
 	}
 
-	buffer = malloc(len);
+	retval = gdb_reserve_mem_buffers(gdb_con, len);
+	if (retval != ERROR_OK)
+		return gdb_error(connection, retval);
+
+	uint8_t *buffer = gdb_con->mem_buffer;
 
 	LOG_DEBUG("addr: 0x%16.16" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
-	retval = target_read_buffer(target, addr, len, buffer);
+	int64_t start = timeval_us();
+	retval = gdb_read_memory(connection, addr, len, buffer);
+	connection->stats.target_time += timeval_us() - start;
 
 	if ((retval != ERROR_OK) && !gdb_report_data_abort) {
 		/* TODO : Here we have to lie and send back all zero's lest stack traces won't work.
@@ -1466,18 +1952,19 @@ static int gdb_read_memory_packet(struct connection *connection,
 	}
 
 	if (retval == ERROR_OK) {
-		hex_buffer = malloc(len * 2 + 1);
-
-		size_t pkt_len = hexify(hex_buffer, buffer, len, len * 2 + 1);
+		char *reply = gdb_con->reply_buffer;
+		size_t pkt_len;
 
-		gdb_put_packet(connection, hex_buffer, pkt_len);
+		if (binary) {
+			reply[0] = 'b';
+			pkt_len = gdb_escape_binary(reply + 1, buffer, len) + 1;
+		} else
+			pkt_len = hexify(reply, buffer, len, len * 2 + 1);
 
-		free(hex_buffer);
+		gdb_put_packet(connection, reply, pkt_len);
 	} else
 		retval = gdb_error(connection, retval);
 
-	free(buffer);
-
 	return retval;
 }
 
@@ -1516,11 +2003,17 @@ static int gdb_write_memory_packet(struct connection *connection,
 	if (unhexify(buffer, separator, len) != len)
 		LOG_ERROR("unable to decode memory packet");
 
+	struct gdb_connection *gdb_con = connection->priv;
+	uint32_t generation = target_get_generation();
+
+	int64_t start = timeval_us();
 	retval = target_write_buffer(target, addr, len, buffer);
+	connection->stats.target_time += timeval_us() - start;
 
-	if (retval == ERROR_OK)
+	if (retval == ERROR_OK) {
+		gdb_mem_cache_write(gdb_con, generation, addr, len, buffer);
 		gdb_put_packet(connection, "OK", 2);
-	else
+	} else
 		retval = gdb_error(connection, retval);
 
 	free(buffer);
@@ -1585,9 +2078,15 @@ static int gdb_write_memory_binary_packet(struct connection *connection,
 	if (len) {
 		LOG_DEBUG("addr: 0x%" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
+		uint32_t generation = target_get_generation();
+		int64_t start = timeval_us();
 		retval = target_write_buffer(target, addr, len, (uint8_t *)separator);
+		connection->stats.target_time += timeval_us() - start;
 		if (retval != ERROR_OK)
 			gdb_connection->mem_write_error = true;
+		else
+			gdb_mem_cache_write(gdb_connection, generation, addr, len,
+					(uint8_t *)separator);
 	}
 
 	if (len < fast_limit) {
@@ -2332,10 +2831,133 @@ error:
 	return retval;
 }
 
-static int gdb_get_target_description_chunk(struct target *target, struct target_desc_format *target_desc,
+static uint32_t gdb_hash_string(uint32_t hash, const char *str)
+{
+	/* FNV-1a */
+	if (str != NULL) {
+		while (*str) {
+			hash ^= (uint8_t)*str++;
+			hash *= 16777619;
+		}
+	}
+	hash ^= 0xff;
+	hash *= 16777619;
+	return hash;
+}
+
+static uint32_t gdb_hash_u32(uint32_t hash, uint32_t value)
+{
+	for (int i = 0; i < 4; i++) {
+		hash ^= value & 0xff;
+		hash *= 16777619;
+		value >>= 8;
+	}
+	return hash;
+}
+
+/* Computes a signature of everything the target description is generated
+ * from, which only changes when the register list is rebuilt or modified. */
+static int gdb_target_description_signature(struct target *target, uint32_t *signature)
+{
+	struct reg **reg_list;
+	int reg_list_size;
+	uint32_t hash = 2166136261;
+
+	int retval = target_get_gdb_reg_list(target, &reg_list,
+			&reg_list_size, REG_CLASS_ALL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	hash = gdb_hash_string(hash, target_get_gdb_arch(target));
+	hash = gdb_hash_u32(hash, reg_list_size);
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *reg = reg_list[i];
+
+		hash = gdb_hash_u32(hash, reg->exist | reg->caller_save << 1);
+		if (reg->exist == false)
+			continue;
+		hash = gdb_hash_string(hash, reg->name);
+		hash = gdb_hash_u32(hash, reg->size);
+		hash = gdb_hash_u32(hash, reg->number);
+		hash = gdb_hash_string(hash, reg->group);
+		hash = gdb_hash_string(hash, reg->feature ? reg->feature->name : NULL);
+		if (reg->reg_data_type != NULL) {
+			hash = gdb_hash_u32(hash, reg->reg_data_type->type);
+			hash = gdb_hash_string(hash, reg->reg_data_type->id);
+			hash = gdb_hash_u32(hash, (uint32_t)(intptr_t)reg->reg_data_type);
+		}
+	}
+
+	free(reg_list);
+
+	*signature = hash;
+	return ERROR_OK;
+}
+
+/* Looks up the target description of a target. It is generated the first
+ * time and again only if the signature of the register list changed. The
+ * signature is checked when GDB starts reading the description (offset 0),
+ * the following chunks are served from the same copy. */
+static int gdb_get_target_description(struct target *target, int32_t offset,
+		struct target_desc_format **target_desc)
+{
+	struct target_desc_format *desc;
+	uint32_t signature;
+	int retval;
+
+	for (desc = gdb_target_descs; desc; desc = desc->next)
+		if (desc->target == target)
+			break;
+
+	if (desc != NULL && offset != 0) {
+		*target_desc = desc;
+		return ERROR_OK;
+	}
+
+	retval = gdb_target_description_signature(target, &signature);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (desc != NULL && desc->signature == signature) {
+		*target_desc = desc;
+		return ERROR_OK;
+	}
+
+	char *tdesc;
+	retval = gdb_generate_target_description(target, &tdesc);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (desc == NULL) {
+		desc = calloc(1, sizeof(*desc));
+		if (desc == NULL) {
+			free(tdesc);
+			return ERROR_FAIL;
+		}
+		desc->target = target;
+		desc->next = gdb_target_descs;
+		gdb_target_descs = desc;
+	} else {
+		LOG_DEBUG("register list of target %s changed, regenerating target description",
+				target_name(target));
+		free(desc->tdesc);
+	}
+
+	desc->signature = signature;
+	desc->tdesc = tdesc;
+	desc->tdesc_length = strlen(tdesc);
+
+	*target_desc = desc;
+	return ERROR_OK;
+}
+
+static int gdb_get_target_description_chunk(struct target *target,
 		char **chunk, int32_t offset, uint32_t length)
 {
-	if (target_desc == NULL) {
+	struct target_desc_format *target_desc;
+
+	int retval = gdb_get_target_description(target, offset, &target_desc);
+	if (retval != ERROR_OK) {
 		LOG_ERROR("Unable to Generate Target Description");
 		return ERROR_FAIL;
 	}
@@ -2343,22 +2965,17 @@ static int gdb_get_target_description_chunk(struct target *target, struct target
 	char *tdesc = target_desc->tdesc;
 	uint32_t tdesc_length = target_desc->tdesc_length;
 
-	if (tdesc == NULL) {
-		int retval = gdb_generate_target_description(target, &tdesc);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Unable to Generate Target Description");
-			return ERROR_FAIL;
-		}
-
-		tdesc_length = strlen(tdesc);
-	}
+	if (offset < 0 || (uint32_t)offset > tdesc_length)
+		offset = tdesc_length;
 
 	char transfer_type;
 
 	if (length < (tdesc_length - offset))
 		transfer_type = 'm';
-	else
+	else {
 		transfer_type = 'l';
+		length = tdesc_length - offset;
+	}
 
 	*chunk = malloc(length + 2);
 	if (*chunk == NULL) {
@@ -2367,21 +2984,8 @@ static int gdb_get_target_description_chunk(struct target *target, struct target
 	}
 
 	(*chunk)[0] = transfer_type;
-	if (transfer_type == 'm') {
-		strncpy((*chunk) + 1, tdesc + offset, length);
-		(*chunk)[1 + length] = '\0';
-	} else {
-		strncpy((*chunk) + 1, tdesc + offset, tdesc_length - offset);
-		(*chunk)[1 + (tdesc_length - offset)] = '\0';
-
-		/* After gdb-server sends out last chunk, invalidate tdesc. */
-		free(tdesc);
-		tdesc = NULL;
-		tdesc_length = 0;
-	}
-
-	target_desc->tdesc = tdesc;
-	target_desc->tdesc_length = tdesc_length;
+	memcpy((*chunk) + 1, tdesc + offset, length);
+	(*chunk)[1 + length] = '\0';
 
 	return ERROR_OK;
 }
@@ -2524,7 +3128,268 @@ static int gdb_get_thread_list_chunk(struct target *target, char **thread_list,
 	return ERROR_OK;
 }
 
-static int gdb_query_packet(struct connection *connection,
+/* Multiprocess support: every target served on the port is a process
+ * with pid target number + 1 and a single thread, or the threads of its
+ * RTOS. GDB attaches to processes with vAttach and selects them with pid
+ * qualified thread ids in H packets, which switches the target of the
+ * gdb service, like the core switching of SMP groups does. Execution
+ * control applies to the selected process only. */
+static bool gdb_mp_attached(struct connection *connection, struct target *target)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	return target->target_number < gdb_con->mp_attached_size &&
+		gdb_con->mp_attached[target->target_number];
+}
+
+static int gdb_mp_set_attached(struct connection *connection, struct target *target,
+		bool attached)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	int num = target->target_number;
+
+	if (num >= gdb_con->mp_attached_size) {
+		bool *t = realloc(gdb_con->mp_attached, (num + 1) * sizeof(bool));
+		if (t == NULL)
+			return ERROR_FAIL;
+		memset(t + gdb_con->mp_attached_size, 0,
+				(num + 1 - gdb_con->mp_attached_size) * sizeof(bool));
+		gdb_con->mp_attached = t;
+		gdb_con->mp_attached_size = num + 1;
+	}
+
+	gdb_con->mp_attached[num] = attached;
+	return ERROR_OK;
+}
+
+/* makes target the one all other packets are applied to */
+static void gdb_mp_select(struct connection *connection, struct target *target)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct gdb_service *gdb_service = connection->service->priv;
+
+	if (gdb_service->target == target)
+		return;
+
+	LOG_DEBUG("gdb selected target %s", target_name(target));
+	gdb_service->target = target;
+	connection->cmd_ctx->current_target = target;
+
+	/* memory read ahead or cached is keyed by address only, it may have
+	 * come from the previously selected target */
+	gdb_con->read_ahead_len = 0;
+	gdb_con->next_read_valid = false;
+	if (gdb_con->mem_cache) {
+		for (int i = 0; i < GDB_MEM_CACHE_LINES; i++)
+			gdb_con->mem_cache[i].valid = false;
+	}
+}
+
+/* forgets about a process; if it was selected, another attached one is */
+static void gdb_mp_release(struct connection *connection, struct target *target)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	gdb_mp_set_attached(connection, target, false);
+
+	if (get_target_from_connection(connection) != target)
+		return;
+
+	for (int i = 0; i < gdb_con->mp_attached_size; i++) {
+		struct target *t = get_target_by_num(i);
+		if (gdb_con->mp_attached[i] && t != NULL) {
+			gdb_mp_select(connection, t);
+			break;
+		}
+	}
+}
+
+/* parses a pid qualified thread id "p<pid>.<tid>", tid may be omitted.
+ * If endp isn't NULL, it is set to the first character after the id. */
+static struct target *gdb_mp_parse_thread_id(char const *id, int64_t *tid, char **endp)
+{
+	char *end;
+	long pid = strtol(id + 1, &end, 16);
+
+	*tid = -1;
+	if (*end == '.')
+		*tid = strtoll(end + 1, &end, 16);
+	if (endp != NULL)
+		*endp = end;
+
+	if (pid <= 0)
+		return NULL;
+
+	return get_target_by_num(pid - 1);
+}
+
+static int gdb_mp_attach(struct connection *connection,
+		char const *packet, int packet_size)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct target *target = get_target_by_num(strtol(packet + 8, NULL, 16) - 1);
+	struct gdb_service *gdb_service = connection->service->priv;
+	char thread[40];
+	char reply[48];
+	int len;
+
+	if (target == NULL || target->gdb_service != gdb_service) {
+		gdb_send_error(connection, 1);
+		return ERROR_OK;
+	}
+
+	if (!gdb_mp_attached(connection, target)) {
+		if (gdb_mp_set_attached(connection, target, true) != ERROR_OK) {
+			gdb_send_error(connection, 1);
+			return ERROR_OK;
+		}
+		target_call_event_callbacks(target, TARGET_EVENT_GDB_ATTACH);
+	}
+
+	/* a process is reported stopped after attaching */
+	if (target->state == TARGET_RUNNING) {
+		if (target_halt(target) == ERROR_OK)
+			target_poll(target);
+	}
+	if (target->state != TARGET_HALTED) {
+		LOG_ERROR("couldn't halt target %s for gdb to attach", target_name(target));
+		gdb_mp_release(connection, target);
+		gdb_send_error(connection, 1);
+		return ERROR_OK;
+	}
+
+	gdb_mp_select(connection, target);
+	gdb_con->frontend_state = TARGET_HALTED;
+
+	rtos_update_threads(target);
+	gdb_stop_reply_thread(connection, target, thread, sizeof(thread));
+	len = snprintf(reply, sizeof(reply), "T%2.2x%s", gdb_last_signal(target), thread);
+	gdb_put_packet(connection, reply, len);
+
+	return ERROR_OK;
+}
+
+static int gdb_mp_detach(struct connection *connection,
+		char const *packet, int packet_size)
+{
+	struct target *target = get_target_by_num(strtol(packet + 2, NULL, 16) - 1);
+	struct gdb_connection *gdb_con = connection->priv;
+	int attached = 0;
+
+	if (target == NULL || !gdb_mp_attached(connection, target)) {
+		gdb_send_error(connection, 1);
+		return ERROR_OK;
+	}
+
+	for (int i = 0; i < gdb_con->mp_attached_size; i++)
+		if (gdb_con->mp_attached[i])
+			attached++;
+
+	/* detaching from the last process closes the connection */
+	if (attached == 1)
+		return GDB_THREAD_PACKET_NOT_CONSUMED;
+
+	target_call_event_callbacks(target, TARGET_EVENT_GDB_END);
+	target_call_event_callbacks(target, TARGET_EVENT_GDB_DETACH);
+	gdb_mp_release(connection, target);
+
+	return gdb_put_packet(connection, "OK", 2);
+}
+
+/* Handles the thread related packets that carry pid qualified thread ids.
+ * Thread ids of an RTOS are passed on to gdb_thread_packet() without the
+ * pid, after the process has been selected. */
+static int gdb_multiprocess_packet(struct connection *connection,
+		char const *packet, int packet_size)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+	int64_t tid;
+
+	if (!gdb_con->multiprocess)
+		return GDB_THREAD_PACKET_NOT_CONSUMED;
+
+	if ((packet[0] == 'H' && packet[2] == 'p') || (packet[0] == 'T' && packet[1] == 'p')) {
+		char const *id = packet + (packet[0] == 'H' ? 2 : 1);
+		char rtos_packet[24];
+
+		/* p-1 selects all processes, p0 any of them */
+		if (strncmp(id, "p-1", 3) == 0 || strncmp(id, "p0.", 3) == 0 || strcmp(id, "p0") == 0) {
+			gdb_put_packet(connection, "OK", 2);
+			return ERROR_OK;
+		}
+
+		struct target *t = gdb_mp_parse_thread_id(id, &tid, NULL);
+		if (t == NULL || !gdb_mp_attached(connection, t)) {
+			gdb_put_packet(connection, "E01", 3);
+			return ERROR_OK;
+		}
+
+		if (packet[0] == 'H')
+			gdb_mp_select(connection, t);
+
+		if (t->rtos == NULL || tid <= 0) {
+			gdb_put_packet(connection, "OK", 2);
+			return ERROR_OK;
+		}
+
+		if (packet[0] == 'H')
+			snprintf(rtos_packet, sizeof(rtos_packet), "H%c%016" PRIx64, packet[1], tid);
+		else
+			snprintf(rtos_packet, sizeof(rtos_packet), "T%016" PRIx64, tid);
+		return gdb_thread_packet(connection, rtos_packet, strlen(rtos_packet));
+	}
+
+	if (strncmp(packet, "qfThreadInfo", 12) == 0) {
+		int retval = ERROR_OK;
+		char *list = NULL;
+		int pos = 0;
+		int size = 0;
+		char sep = 'm';
+
+		for (int i = 0; i < gdb_con->mp_attached_size; i++) {
+			struct target *t = get_target_by_num(i);
+			if (!gdb_con->mp_attached[i] || t == NULL)
+				continue;
+
+			if (t->rtos != NULL && t->rtos->thread_count > 0) {
+				for (int j = 0; j < t->rtos->thread_count; j++) {
+					xml_printf(&retval, &list, &pos, &size, "%cp%x.%" PRIx64,
+							sep, i + 1, t->rtos->thread_details[j].threadid);
+					sep = ',';
+				}
+			} else {
+				xml_printf(&retval, &list, &pos, &size, "%cp%x.1", sep, i + 1);
+				sep = ',';
+			}
+		}
+
+		if (retval != ERROR_OK || list == NULL)
+			gdb_put_packet(connection, "l", 1);
+		else
+			gdb_put_packet(connection, list, pos);
+		free(list);
+		return ERROR_OK;
+	}
+
+	if (strncmp(packet, "qsThreadInfo", 12) == 0) {
+		gdb_put_packet(connection, "l", 1);
+		return ERROR_OK;
+	}
+
+	if (strcmp(packet, "qC") == 0) {
+		char reply[40];
+		int len = snprintf(reply, sizeof(reply), "QCp%x.%" PRIx64,
+				target->target_number + 1,
+				target->rtos != NULL ? target->rtos->current_thread : 1);
+		gdb_put_packet(connection, reply, len);
+		return ERROR_OK;
+	}
+
+	return GDB_THREAD_PACKET_NOT_CONSUMED;
+}
+
+static int gdb_query_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
 	struct command_context *cmd_ctx = connection->cmd_ctx;
@@ -2613,10 +3478,19 @@ static int gdb_query_packet(struct connection *connection,
 			&buffer,
 			&pos,
 			&size,
-			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+",
-			(GDB_BUFFER_SIZE - 1),
+			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read%c;QStartNoAckMode+;vContSupported+;binary-upload+;QNonStop+%s",
+			(gdb_connection->packet_buffer_size - 1),
 			((gdb_use_memory_map == 1) && (flash_get_bank_count() > 0)) ? '+' : '-',
-			(gdb_target_desc_supported == 1) ? '+' : '-');
+			(gdb_target_desc_supported == 1) ? '+' : '-',
+			/* the thread list is sent with qfThreadInfo in multiprocess mode */
+			gdb_multiprocess ? '-' : '+',
+			gdb_multiprocess ? ";multiprocess+" : "");
+
+		/* gdb announces the extension as well if it wants to use it */
+		if (gdb_multiprocess && strstr(packet, "multiprocess+") != NULL) {
+			gdb_connection->multiprocess = true;
+			gdb_mp_set_attached(connection, target, true);
+		}
 
 		if (retval != ERROR_OK) {
 			gdb_send_error(connection, 01);
@@ -2650,7 +3524,7 @@ static int gdb_query_packet(struct connection *connection,
 		 * there are *more* chunks to transfer. 'l' for it is the *last*
 		 * chunk of target description.
 		 */
-		retval = gdb_get_target_description_chunk(target, &gdb_connection->target_desc,
+		retval = gdb_get_target_description_chunk(target,
 				&xml, offset, length);
 		if (retval != ERROR_OK) {
 			gdb_error(connection, retval);
@@ -2696,6 +3570,16 @@ static int gdb_query_packet(struct connection *connection,
 		gdb_connection->noack_mode = 1;
 		gdb_put_packet(connection, "OK", 2);
 		return ERROR_OK;
+	} else if (strncmp(packet, "QNonStop:", 9) == 0) {
+		if (packet[9] == '1' && target->type->step == NULL) {
+			/* non-stop requires vCont support */
+			gdb_send_error(connection, 01);
+			return ERROR_OK;
+		}
+		gdb_connection->non_stop = packet[9] == '1';
+		LOG_DEBUG("%s-stop mode", gdb_connection->non_stop ? "non" : "all");
+		gdb_put_packet(connection, "OK", 2);
+		return ERROR_OK;
 	}
 
 	gdb_put_packet(connection, "", 0);
@@ -2713,7 +3597,7 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 	if (parse[0] == '?') {
 		if (target->type->step != NULL) {
 			/* gdb doesn't accept c without C and s without S */
-			gdb_put_packet(connection, "vCont;c;C;s;S", 13);
+			gdb_put_packet(connection, "vCont;c;C;s;S;t", 15);
 			return true;
 		}
 		return false;
@@ -2724,8 +3608,54 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 		--packet_size;
 	}
 
+	/* in multiprocess mode the action applies to the process named in its
+	 * thread id; p-1 (all) and p0 (any) keep the selected one */
+	if (gdb_connection->multiprocess && parse[0] != '\0' && strncmp(parse + 1, ":p", 2) == 0 &&
+			strncmp(parse + 2, "p-1", 3) != 0 && strncmp(parse + 2, "p0", 2) != 0) {
+		int64_t tid;
+		struct target *t = gdb_mp_parse_thread_id(parse + 2, &tid, NULL);
+		if (t == NULL || !gdb_mp_attached(connection, t)) {
+			gdb_put_packet(connection, "E01", 3);
+			return true;
+		}
+		gdb_mp_select(connection, t);
+		target = t;
+	}
+
+	/* stop request, only used in non-stop mode */
+	if (parse[0] == 't' && gdb_connection->non_stop) {
+		struct target *ct = target;
+
+		gdb_put_packet(connection, "OK", 2);
+
+		/* a stop is only reported for threads that are not already stopped */
+		if (gdb_connection->frontend_state != TARGET_RUNNING)
+			return true;
+
+		if (target->rtos != NULL)
+			target->rtos->gdb_target_for_threadid(connection, target->rtos->current_threadid, &ct);
+
+		gdb_connection->vcont_stop = true;
+		if (ct->state == TARGET_RUNNING) {
+			LOG_DEBUG("target %s stop", target_name(ct));
+			retval = target_halt(ct);
+			if (retval == ERROR_OK)
+				retval = target_poll(ct);
+			if (retval != ERROR_OK)
+				target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
+		} else
+			target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
+
+		return true;
+	}
+
 	/* simple case, a continue packet */
 	if (parse[0] == 'c') {
+		/* in non-stop mode the resume is acknowledged right away and the
+		 * stop is reported with a notification later on */
+		if (gdb_connection->non_stop)
+			gdb_put_packet(connection, "OK", 2);
+
 		gdb_running_type = 'c';
 		LOG_DEBUG("target %s continue", target_name(target));
 		log_add_callback(gdb_log_callback, connection);
@@ -2762,10 +3692,16 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 			int64_t thread_id;
 			char *endp;
 
+			if (gdb_connection->non_stop)
+				gdb_put_packet(connection, "OK", 2);
+
 			parse += 2;
 			packet_size -= 2;
 
-			thread_id = strtoll(parse, &endp, 16);
+			if (parse[0] == 'p')
+				gdb_mp_parse_thread_id(parse, &thread_id, &endp);
+			else
+				thread_id = strtoll(parse, &endp, 16);
 			if (endp != NULL) {
 				packet_size -= endp - parse;
 				parse = endp;
@@ -2781,7 +3717,7 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 				 * check if the thread to be stepped is the current rtos thread
 				 * if not, we must fake the step
 				 */
-				if (target->rtos->current_thread != thread_id)
+				if (thread_id > 0 && target->rtos->current_thread != thread_id)
 					fake_step = true;
 			}
 
@@ -2799,7 +3735,10 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 						parse += 1;
 						packet_size -= 1;
 
-						tid = strtoll(parse, &endp, 16);
+						if (parse[0] == 'p')
+							gdb_mp_parse_thread_id(parse, &tid, &endp);
+						else
+							tid = strtoll(parse, &endp, 16);
 						if (tid == thread_id) {
 							/*
 							 * Special case: only step a single thread (core),
@@ -2836,10 +3775,15 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 
 				LOG_DEBUG("fake step thread %"PRIx64, thread_id);
 
-				sig_reply_len = snprintf(sig_reply, sizeof(sig_reply),
-										 "T05thread:%016"PRIx64";", thread_id);
+				if (gdb_connection->multiprocess)
+					sig_reply_len = snprintf(sig_reply, sizeof(sig_reply),
+											 "T05thread:p%x.%" PRIx64 ";",
+											 target->target_number + 1, thread_id);
+				else
+					sig_reply_len = snprintf(sig_reply, sizeof(sig_reply),
+											 "T05thread:%016"PRIx64";", thread_id);
 
-				gdb_put_packet(connection, sig_reply, sig_reply_len);
+				gdb_put_stop_reply(connection, sig_reply, sig_reply_len);
 				log_remove_callback(gdb_log_callback, connection);
 
 				return true;
@@ -2883,6 +3827,102 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 	return false;
 }
 
+/* Programs the flash sectors which are completely covered by the vFlash
+ * image received so far. The data of the last, possibly incomplete sector
+ * is kept in the image until more data arrives or vFlashDone is received. */
+static int gdb_vflash_stream(struct connection *connection, target_addr_t end)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+	struct image *image = gdb_connection->vflash_image;
+	struct flash_bank *bank;
+	struct image flush_image;
+	struct image *rest;
+	target_addr_t limit;
+	uint32_t pending = 0;
+	uint32_t written;
+	int retval;
+
+	retval = get_flash_bank_by_addr(target, end - 1, false, &bank);
+	if (retval != ERROR_OK)
+		return retval;
+	/* data outside of flash is reported by vFlashDone */
+	if (bank == NULL || bank->num_sectors == 0)
+		return ERROR_OK;
+
+	/* stop at the start of the sector the data ends in, unless it ends
+	 * exactly at the end of that sector */
+	uint32_t offset = end - bank->base;
+	limit = end;
+	for (int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		if (offset > sector->offset && offset <= sector->offset + sector->size) {
+			if (offset != sector->offset + sector->size)
+				limit = bank->base + sector->offset;
+			break;
+		}
+	}
+
+	for (int i = 0; i < image->num_sections; i++) {
+		struct imagesection *section = &image->sections[i];
+		if (section->base_address >= limit)
+			continue;
+		if (section->base_address + section->size > limit)
+			pending += limit - section->base_address;
+		else
+			pending += section->size;
+	}
+
+	if (pending == 0 || pending < gdb_flash_stream_size)
+		return ERROR_OK;
+
+	rest = malloc(sizeof(struct image));
+	if (rest == NULL)
+		return ERROR_FAIL;
+	image_open(&flush_image, "", "build");
+	image_open(rest, "", "build");
+
+	/* split the image at the limit */
+	for (int i = 0; i < image->num_sections; i++) {
+		struct imagesection *section = &image->sections[i];
+		const uint8_t *data = section->private;
+		uint32_t size = 0;
+
+		if (section->base_address < limit) {
+			size = section->size;
+			if (section->base_address + size > limit)
+				size = limit - section->base_address;
+			image_add_section(&flush_image, section->base_address, size, section->flags, data);
+		}
+		if (size < section->size)
+			image_add_section(rest, section->base_address + size, section->size - size,
+					section->flags, data + size);
+	}
+
+	image_close(image);
+	free(image);
+	gdb_connection->vflash_image = rest;
+	gdb_connection->vflash_stream_limit = limit;
+
+	if (!gdb_connection->vflash_write_started) {
+		target_call_event_callbacks(target,
+				TARGET_EVENT_GDB_FLASH_WRITE_START);
+		gdb_connection->vflash_write_started = true;
+	}
+
+	LOG_DEBUG("programming %" PRIu32 " bytes of vFlash image below " TARGET_ADDR_FMT,
+			pending, limit);
+	int64_t start = timeval_us();
+	retval = flash_write(target, &flush_image, &written, 0);
+	connection->stats.target_time += timeval_us() - start;
+	if (retval == ERROR_OK)
+		gdb_connection->vflash_written += written;
+
+	image_close(&flush_image);
+
+	return retval;
+}
+
 static int gdb_v_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -2892,6 +3932,30 @@ static int gdb_v_packet(struct connection *connection,
 
 	target = get_target_from_connection(connection);
 
+	if (gdb_connection->multiprocess) {
+		if (strncmp(packet, "vAttach;", 8) == 0)
+			return gdb_mp_attach(connection, packet, packet_size);
+
+		if (strncmp(packet, "vKill;", 6) == 0) {
+			/* targets can't be killed, just forget about the process */
+			struct target *t = get_target_by_num(strtol(packet + 6, NULL, 16) - 1);
+			if (t == NULL || !gdb_mp_attached(connection, t)) {
+				gdb_send_error(connection, 1);
+				return ERROR_OK;
+			}
+			gdb_mp_release(connection, t);
+			gdb_put_packet(connection, "OK", 2);
+			return ERROR_OK;
+		}
+	}
+
+	if (strncmp(packet, "vStopped", 8) == 0) {
+		/* stops are reported as soon as they happen, so there is never
+		 * another one queued when GDB acknowledges a notification */
+		gdb_put_packet(connection, "OK", 2);
+		return ERROR_OK;
+	}
+
 	if (strncmp(packet, "vCont", 5) == 0) {
 		bool handled;
 
@@ -2936,6 +4000,11 @@ static int gdb_v_packet(struct connection *connection,
 			return ERROR_SERVER_REMOTE_CLOSED;
 		}
 
+		/* a new load starts, forget what is left of an aborted one */
+		if (gdb_connection->vflash_image || gdb_connection->vflash_write_started)
+			LOG_DEBUG("discarding data of an unfinished vFlash load");
+		gdb_vflash_reset(connection);
+
 		/* assume all sectors need erasing - stops any problems
 		 * when flash_write is called multiple times */
 		flash_set_dirty();
@@ -2948,8 +4017,10 @@ static int gdb_v_packet(struct connection *connection,
 		 * end to be "block" aligned ... if padding is ever needed,
 		 * GDB will have become dangerously confused.
 		 */
+		int64_t start = timeval_us();
 		result = flash_erase_address_range(target, false, addr,
 			length);
+		connection->stats.target_time += timeval_us() - start;
 
 		/* perform any target specific operations after the erase */
 		target_call_event_callbacks(target,
@@ -2985,6 +4056,14 @@ static int gdb_v_packet(struct connection *connection,
 		}
 		length = packet_size - (parse - packet);
 
+		/* data for sectors already programmed can't be merged anymore */
+		if (addr < gdb_connection->vflash_stream_limit) {
+			LOG_ERROR("vFlashWrite at 0x%8.8lx below already programmed address "
+					TARGET_ADDR_FMT, addr, gdb_connection->vflash_stream_limit);
+			gdb_send_error(connection, EIO);
+			return ERROR_OK;
+		}
+
 		/* create a new image if there isn't already one */
 		if (gdb_connection->vflash_image == NULL) {
 			gdb_connection->vflash_image = malloc(sizeof(struct image));
@@ -2997,6 +4076,21 @@ static int gdb_v_packet(struct connection *connection,
 		if (retval != ERROR_OK)
 			return retval;
 
+		/* program complete sectors while gdb is still sending */
+		if (gdb_flash_stream_size && length) {
+			retval = gdb_vflash_stream(connection, addr + length);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("flash_write returned %i", retval);
+				/* gdb aborts the load without vFlashDone */
+				gdb_vflash_reset(connection);
+				if (retval == ERROR_FLASH_DST_OUT_OF_BANK)
+					gdb_put_packet(connection, "E.memtype", 9);
+				else
+					gdb_send_error(connection, EIO);
+				return ERROR_OK;
+			}
+		}
+
 		gdb_put_packet(connection, "OK", 2);
 
 		return ERROR_OK;
@@ -3006,11 +4100,19 @@ static int gdb_v_packet(struct connection *connection,
 		uint32_t written;
 
 		/* process the flashing buffer. No need to erase as GDB
-		 * always issues a vFlashErase first. */
-		target_call_event_callbacks(target,
-				TARGET_EVENT_GDB_FLASH_WRITE_START);
-		result = flash_write(target, gdb_connection->vflash_image,
-			&written, 0);
+		 * always issues a vFlashErase first. Sectors programmed
+		 * while streaming are already gone from the image. */
+		if (!gdb_connection->vflash_write_started)
+			target_call_event_callbacks(target,
+					TARGET_EVENT_GDB_FLASH_WRITE_START);
+		written = 0;
+		result = ERROR_OK;
+		if (gdb_connection->vflash_image) {
+			int64_t start = timeval_us();
+			result = flash_write(target, gdb_connection->vflash_image,
+				&written, 0);
+			connection->stats.target_time += timeval_us() - start;
+		}
 		target_call_event_callbacks(target,
 			TARGET_EVENT_GDB_FLASH_WRITE_END);
 		if (result != ERROR_OK) {
@@ -3019,13 +4121,14 @@ static int gdb_v_packet(struct connection *connection,
 			else
 				gdb_send_error(connection, EIO);
 		} else {
+			written += gdb_connection->vflash_written;
 			LOG_DEBUG("wrote %u bytes from vFlash image to flash", (unsigned)written);
 			gdb_put_packet(connection, "OK", 2);
 		}
 
-		image_close(gdb_connection->vflash_image);
-		free(gdb_connection->vflash_image);
-		gdb_connection->vflash_image = NULL;
+		/* the WRITE_END event was already sent */
+		gdb_connection->vflash_write_started = false;
+		gdb_vflash_reset(connection);
 
 		return ERROR_OK;
 	}
@@ -3104,26 +4207,34 @@ static void gdb_log_callback(void *priv, const char *file, unsigned line,
 		return;
 	}
 
+	/* in non-stop mode GDB doesn't wait for a reply while the target
+	 * runs, so there is no packet the output could be sent with */
+	if (gdb_con->non_stop && gdb_con->frontend_state == TARGET_RUNNING)
+		return;
+
 	gdb_output_con(connection, string);
 }
 
 static void gdb_sig_halted(struct connection *connection)
 {
-	char sig_reply[4];
-	snprintf(sig_reply, 4, "T%2.2x", 2);
-	gdb_put_packet(connection, sig_reply, 3);
+	char thread[40];
+	char sig_reply[48];
+	int len;
+
+	gdb_stop_reply_thread(connection, get_target_from_connection(connection),
+			thread, sizeof(thread));
+	len = snprintf(sig_reply, sizeof(sig_reply), "T%2.2x%s", 2, thread);
+	gdb_put_stop_reply(connection, sig_reply, len);
 }
 
 static int gdb_input_inner(struct connection *connection)
 {
-	/* Do not allocate this on the stack */
-	static char gdb_packet_buffer[GDB_BUFFER_SIZE];
-
 	struct target *target;
-	char const *packet = gdb_packet_buffer;
 	int packet_size;
 	int retval;
 	struct gdb_connection *gdb_con = connection->priv;
+	char *gdb_packet_buffer = gdb_con->packet_buffer;
+	char const *packet = gdb_packet_buffer;
 	static int extended_protocol;
 
 	target = get_target_from_connection(connection);
@@ -3140,7 +4251,7 @@ static int gdb_input_inner(struct connection *connection)
 	 * drain the rest of the buffer.
 	 */
 	do {
-		packet_size = GDB_BUFFER_SIZE-1;
+		packet_size = gdb_con->packet_buffer_size - 1;
 		retval = gdb_get_packet(connection, gdb_packet_buffer, &packet_size);
 		if (retval != ERROR_OK)
 			return retval;
@@ -3163,17 +4274,34 @@ static int gdb_input_inner(struct connection *connection)
 
 		if (packet_size > 0) {
 			retval = ERROR_OK;
+
+			if ((unsigned char)packet[0] < ARRAY_SIZE(connection->stats.packets))
+				connection->stats.packets[(unsigned char)packet[0]]++;
+
+			/* anything but another read may change memory, so forget
+			 * data that was read ahead */
+			if (packet[0] != 'm' && packet[0] != 'x') {
+				gdb_con->read_ahead_len = 0;
+				gdb_con->next_read_valid = false;
+			}
+
 			switch (packet[0]) {
 				case 'T':	/* Is thread alive? */
-					gdb_thread_packet(connection, packet, packet_size);
+					if (gdb_multiprocess_packet(connection, packet, packet_size)
+							== GDB_THREAD_PACKET_NOT_CONSUMED)
+						gdb_thread_packet(connection, packet, packet_size);
 					break;
 				case 'H':	/* Set current thread ( 'c' for step and continue,
 							 * 'g' for all other operations ) */
-					gdb_thread_packet(connection, packet, packet_size);
+					if (gdb_multiprocess_packet(connection, packet, packet_size)
+							== GDB_THREAD_PACKET_NOT_CONSUMED)
+						gdb_thread_packet(connection, packet, packet_size);
 					break;
 				case 'q':
 				case 'Q':
-					retval = gdb_thread_packet(connection, packet, packet_size);
+					retval = gdb_multiprocess_packet(connection, packet, packet_size);
+					if (retval == GDB_THREAD_PACKET_NOT_CONSUMED)
+						retval = gdb_thread_packet(connection, packet, packet_size);
 					if (retval == GDB_THREAD_PACKET_NOT_CONSUMED)
 						retval = gdb_query_packet(connection, packet, packet_size);
 					break;
@@ -3190,6 +4318,7 @@ static int gdb_input_inner(struct connection *connection)
 					retval = gdb_set_register_packet(connection, packet, packet_size);
 					break;
 				case 'm':
+				case 'x':
 					retval = gdb_read_memory_packet(connection, packet, packet_size);
 					break;
 				case 'M':
@@ -3275,6 +4404,11 @@ static int gdb_input_inner(struct connection *connection)
 					retval = gdb_v_packet(connection, packet, packet_size);
 					break;
 				case 'D':
+					if (gdb_con->multiprocess && packet[1] == ';') {
+						retval = gdb_mp_detach(connection, packet, packet_size);
+						if (retval != GDB_THREAD_PACKET_NOT_CONSUMED)
+							break;
+					}
 					retval = gdb_detach(connection);
 					extended_protocol = 0;
 					break;
@@ -3477,11 +4611,28 @@ int gdb_target_add_all(struct target *target)
 		return ERROR_OK;
 	}
 
+	struct gdb_service *shared = NULL;
+
 	while (NULL != target) {
+		/* in multiprocess mode the targets without a port of their own
+		 * are served on the port of the first target */
+		if (gdb_multiprocess && shared != NULL && target->gdb_service == NULL &&
+				target->gdb_port_override == NULL &&
+				target_supports_gdb_connection(target)) {
+			LOG_DEBUG("serving target %s on the gdb port of %s",
+					target_name(target), target_name(shared->target));
+			target->gdb_service = shared;
+			target = target->next;
+			continue;
+		}
+
 		int retval = gdb_target_add_one(target);
 		if (ERROR_OK != retval)
 			return retval;
 
+		if (shared == NULL)
+			shared = target->gdb_service;
+
 		target = target->next;
 	}
 
@@ -3584,6 +4735,114 @@ COMMAND_HANDLER(handle_gdb_target_description_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_packet_size_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int size;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], size);
+		if (size < 1024 || size > 1024 * 1024) {
+			command_print(CMD_CTX, "packet size must be between 1024 and 1048576 bytes");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		gdb_packet_size = size;
+	}
+
+	command_print(CMD_CTX, "gdb packet size: %u", gdb_packet_size);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_gdb_read_ahead_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int size;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], size);
+		if (size > 16 * 1024 * 1024) {
+			command_print(CMD_CTX, "read ahead size must not exceed 16 MiB");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		if (gdb_actual_connections) {
+			command_print(CMD_CTX, "read ahead size can't be changed while GDB is connected");
+			return ERROR_FAIL;
+		}
+		gdb_read_ahead_size = size;
+	}
+
+	command_print(CMD_CTX, "gdb read ahead: %u bytes", gdb_read_ahead_size);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_gdb_flash_stream_size_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], gdb_flash_stream_size);
+
+	command_print(CMD_CTX, "gdb flash stream size: %u bytes", gdb_flash_stream_size);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_gdb_multiprocess_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_multiprocess);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_gdb_memory_cache_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_use_memory_cache);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_gdb_memory_cache_exclude_command)
+{
+	if (CMD_ARGC == 0) {
+		for (unsigned int i = 0; i < gdb_mem_cache_exclude_count; i++)
+			command_print(CMD_CTX, TARGET_ADDR_FMT " 0x%8.8" PRIx32,
+					gdb_mem_cache_excludes[i].address,
+					gdb_mem_cache_excludes[i].size);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_addr_t address;
+	uint32_t size;
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+	if (size == 0)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	struct gdb_mem_cache_exclude *excludes = realloc(gdb_mem_cache_excludes,
+			(gdb_mem_cache_exclude_count + 1) * sizeof(*excludes));
+	if (excludes == NULL)
+		return ERROR_FAIL;
+
+	excludes[gdb_mem_cache_exclude_count].address = address;
+	excludes[gdb_mem_cache_exclude_count].size = size;
+	gdb_mem_cache_excludes = excludes;
+	gdb_mem_cache_exclude_count++;
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 {
 	char *tdesc;
@@ -3694,6 +4953,56 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable target description",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_packet_size",
+		.handler = handle_gdb_packet_size_command,
+		.mode = COMMAND_ANY,
+		.help = "Display or set the maximum packet size advertised "
+			"to GDB, takes effect for new connections",
+		.usage = "[size]",
+	},
+	{
+		.name = "gdb_read_ahead",
+		.handler = handle_gdb_read_ahead_command,
+		.mode = COMMAND_ANY,
+		.help = "Display or set the number of bytes read from the "
+			"target at once when GDB reads memory sequentially, "
+			"0 disables read ahead",
+		.usage = "[size]",
+	},
+	{
+		.name = "gdb_multiprocess",
+		.handler = handle_gdb_multiprocess_command,
+		.mode = COMMAND_CONFIG,
+		.help = "enable or disable serving all targets on one gdb port "
+			"as processes of GDB's multiprocess extensions",
+		.usage = "('enable'|'disable')"
+	},
+	{
+		.name = "gdb_flash_stream_size",
+		.handler = handle_gdb_flash_stream_size_command,
+		.mode = COMMAND_ANY,
+		.help = "Display or set the amount of complete flash sectors "
+			"received from GDB that are programmed before vFlashDone, "
+			"0 programs the whole image at vFlashDone",
+		.usage = "[size]",
+	},
+	{
+		.name = "gdb_memory_cache",
+		.handler = handle_gdb_memory_cache_command,
+		.mode = COMMAND_ANY,
+		.help = "enable or disable caching of memory read by GDB "
+			"while the targets are stopped",
+		.usage = "('enable'|'disable')"
+	},
+	{
+		.name = "gdb_memory_cache_exclude",
+		.handler = handle_gdb_memory_cache_exclude_command,
+		.mode = COMMAND_ANY,
+		.help = "Exclude a memory range, e.g. peripherals, from the "
+			"GDB memory cache. Without arguments lists the excluded ranges.",
+		.usage = "[address size]",
+	},
 	{
 		.name = "gdb_save_tdesc",
 		.handler = handle_gdb_save_tdesc_command,
@@ -3715,4 +5024,12 @@ void gdb_service_free(void)
 {
 	free(gdb_port);
 	free(gdb_port_next);
+	free(gdb_mem_cache_excludes);
+
+	while (gdb_target_descs) {
+		struct target_desc_format *next = gdb_target_descs->next;
+		free(gdb_target_descs->tdesc);
+		free(gdb_target_descs);
+		gdb_target_descs = next;
+	}
 }
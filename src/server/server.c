@@ -27,6 +27,7 @@
 #endif
 
 #include "server.h"
+#include <helper/time_support.h>
 #include <target/target.h>
 #include <target/target_request.h>
 #include <target/openrisc/jsp_server.h>
@@ -44,6 +45,10 @@
 #include <netinet/tcp.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 static struct service *services;
 
 enum shutdown_reason {
@@ -63,6 +68,70 @@ static int polling_period = 100;
 /* address by name on which to listen for incoming TCP/IP connections */
 static char *bindto_name;
 
+/* file the connection statistics are written to on exit, if set */
+static char *stats_file_name;
+
+#ifdef HAVE_SYS_EPOLL_H
+/* maximum number of ready fds reported by a single epoll_wait() */
+#define SERVER_MAX_EVENTS	32
+
+/* epoll instance watching all service and connection fds */
+static int epoll_fd = -1;
+/* set when a fd could not be added to epoll (e.g. stdin redirected from a
+ * regular file), server_loop() then falls back to select() */
+static bool epoll_failed;
+#endif
+
+/* Start watching fd for input, the event loop sets *ready when data or a
+ * new connection is pending. Watching an fd already known to the event
+ * loop just redirects the notification to the new flag. */
+static void server_watch_fd(int fd, bool *ready)
+{
+	*ready = false;
+
+#ifdef HAVE_SYS_EPOLL_H
+	if (fd == -1 || epoll_failed)
+		return;
+
+	if (epoll_fd == -1) {
+		epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (epoll_fd == -1) {
+			LOG_DEBUG("epoll not available (%s), using select()", strerror(errno));
+			epoll_failed = true;
+			return;
+		}
+	}
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = ready;
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+		if (errno != EEXIST || epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+			LOG_DEBUG("can't watch fd %d with epoll (%s), using select()",
+				fd, strerror(errno));
+			epoll_failed = true;
+		}
+	}
+#endif
+}
+
+/* Stop watching fd, must be called before fd is closed or handed over */
+static void server_unwatch_fd(int fd)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (fd == -1 || epoll_fd == -1)
+		return;
+
+	/* kernels before 2.6.9 require a non-NULL event even for EPOLL_CTL_DEL,
+	 * errors are ignored as the fd might never have been added */
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+#endif
+}
+
 static int add_connection(struct service *service, struct command_context *cmd_ctx)
 {
 	socklen_t address_size;
@@ -77,6 +146,8 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	c->cmd_ctx = copy_command_context(cmd_ctx);
 	c->service = service;
 	c->input_pending = 0;
+	c->fd_ready = false;
+	memset(&c->stats, 0, sizeof(c->stats));
 	c->priv = NULL;
 	c->next = NULL;
 
@@ -106,6 +177,8 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 			free(c);
 			return retval;
 		}
+
+		server_watch_fd(c->fd, &c->fd_ready);
 	} else if (service->type == CONNECTION_STDINOUT) {
 		c->fd = service->fd;
 		c->fd_out = fileno(stdout);
@@ -121,11 +194,14 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 		LOG_INFO("accepting '%s' connection from pipe", service->name);
 		retval = service->new_connection(c);
 		if (retval != ERROR_OK) {
+			server_unwatch_fd(c->fd);
 			LOG_ERROR("attempted '%s' connection rejected", service->name);
 			command_done(c->cmd_ctx);
 			free(c);
 			return retval;
 		}
+
+		server_watch_fd(c->fd, &c->fd_ready);
 	} else if (service->type == CONNECTION_PIPE) {
 		c->fd = service->fd;
 		/* do not check for new connections again on stdin */
@@ -135,6 +211,7 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 		c->fd_out = open(out_file, O_WRONLY);
 		free(out_file);
 		if (c->fd_out == -1) {
+			server_unwatch_fd(c->fd);
 			LOG_ERROR("could not open %s", service->port);
 			command_done(c->cmd_ctx);
 			free(c);
@@ -144,11 +221,14 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 		LOG_INFO("accepting '%s' connection from pipe %s", service->name, service->port);
 		retval = service->new_connection(c);
 		if (retval != ERROR_OK) {
+			server_unwatch_fd(c->fd);
 			LOG_ERROR("attempted '%s' connection rejected", service->name);
 			command_done(c->cmd_ctx);
 			free(c);
 			return retval;
 		}
+
+		server_watch_fd(c->fd, &c->fd_ready);
 	}
 
 	/* add to the end of linked list */
@@ -162,6 +242,32 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	return ERROR_OK;
 }
 
+static void connection_stats_add(struct connection_stats *total,
+		const struct connection_stats *stats)
+{
+	total->requests += stats->requests;
+	for (unsigned int i = 0; i < ARRAY_SIZE(total->packets); i++)
+		total->packets[i] += stats->packets[i];
+	total->bytes_in += stats->bytes_in;
+	total->bytes_out += stats->bytes_out;
+	total->handler_time += stats->handler_time;
+	total->target_time += stats->target_time;
+	for (unsigned int i = 0; i < CONNECTION_STATS_BUCKETS; i++)
+		total->histogram[i] += stats->histogram[i];
+}
+
+static void connection_stats_request(struct connection_stats *stats, int64_t time)
+{
+	unsigned int bucket = 0;
+
+	while (bucket < CONNECTION_STATS_BUCKETS - 1 && time >= (1LL << bucket))
+		bucket++;
+
+	stats->requests++;
+	stats->handler_time += time;
+	stats->histogram[bucket]++;
+}
+
 static int remove_connection(struct service *service, struct connection *connection)
 {
 	struct connection **p = &service->connections;
@@ -171,12 +277,17 @@ static int remove_connection(struct service *service, struct connection *connect
 	while ((c = *p)) {
 		if (c->fd == connection->fd) {
 			service->connection_closed(c);
-			if (service->type == CONNECTION_TCP)
+			connection_stats_add(&service->stats, &c->stats);
+			service->num_closed++;
+			if (service->type == CONNECTION_TCP) {
+				server_unwatch_fd(c->fd);
 				close_socket(c->fd);
-			else if (service->type == CONNECTION_PIPE) {
+			} else if (service->type == CONNECTION_PIPE) {
 				/* The service will listen to the pipe again */
 				c->service->fd = c->fd;
-			}
+				server_watch_fd(c->service->fd, &c->service->fd_ready);
+			} else
+				server_unwatch_fd(c->fd);
 
 			command_done(c->cmd_ctx);
 
@@ -222,7 +333,10 @@ int add_service(char *name,
 	c->port = strdup(port);
 	c->max_connections = 1;	/* Only TCP/IP ports can support more than one connection */
 	c->fd = -1;
+	c->fd_ready = false;
 	c->connections = NULL;
+	memset(&c->stats, 0, sizeof(c->stats));
+	c->num_closed = 0;
 	c->new_connection = new_connection_handler;
 	c->input = input_handler;
 	c->connection_closed = connection_closed_handler;
@@ -341,6 +455,8 @@ int add_service(char *name,
 #endif
 	}
 
+	server_watch_fd(c->fd, &c->fd_ready);
+
 	/* add to the end of linked list */
 	for (p = &services; *p; p = &(*p)->next)
 		;
@@ -380,6 +496,7 @@ int remove_service(const char *name, const char *port)
 			else
 				prev->next = tmp->next;
 
+			server_unwatch_fd(tmp->fd);
 			if (tmp->type != CONNECTION_STDINOUT)
 				close_socket(tmp->fd);
 
@@ -403,6 +520,8 @@ static int remove_services(void)
 
 		remove_connections(c);
 
+		server_unwatch_fd(c->fd);
+
 		if (c->name)
 			free(c->name);
 
@@ -428,65 +547,104 @@ static int remove_services(void)
 	return ERROR_OK;
 }
 
-int server_loop(struct command_context *command_context)
+/* Wait at most timeout_ms for input on any service or connection fd and
+ * set the fd_ready flag of those that have some. Returns the number of
+ * ready fds, 0 on timeout and -1 on error, just like select(). */
+static int server_wait_fds(int timeout_ms)
 {
 	struct service *service;
+	struct connection *c;
 
-	bool poll_ok = true;
+#ifdef HAVE_SYS_EPOLL_H
+	if (epoll_fd != -1 && !epoll_failed) {
+		struct epoll_event events[SERVER_MAX_EVENTS];
+
+		int retval = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, timeout_ms);
+		for (int i = 0; i < retval; i++)
+			*(bool *)events[i].data.ptr = true;
+
+		return retval;
+	}
+#endif
 
-	/* used in select() */
 	fd_set read_fds;
-	int fd_max;
+	int fd_max = 0;
+	FD_ZERO(&read_fds);
+
+	/* add service and connection fds to read_fds */
+	for (service = services; service; service = service->next) {
+		if (service->fd != -1) {
+			/* listen for new connections */
+			FD_SET(service->fd, &read_fds);
+
+			if (service->fd > fd_max)
+				fd_max = service->fd;
+		}
+
+		for (c = service->connections; c; c = c->next) {
+			/* check for activity on the connection */
+			FD_SET(c->fd, &read_fds);
+			if (c->fd > fd_max)
+				fd_max = c->fd;
+		}
+	}
+
+	struct timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+	int retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+	if (retval <= 0)
+		return retval;	/* eCos leaves read_fds unchanged on timeout! */
+
+	for (service = services; service; service = service->next) {
+		if (service->fd != -1 && FD_ISSET(service->fd, &read_fds))
+			service->fd_ready = true;
+
+		for (c = service->connections; c; c = c->next) {
+			if (FD_ISSET(c->fd, &read_fds))
+				c->fd_ready = true;
+		}
+	}
+
+	return retval;
+}
+
+int server_loop(struct command_context *command_context)
+{
+	struct service *service;
+
+	bool poll_ok = true;
 
 	/* used in accept() */
 	int retval;
 
+	/* when the earliest target timer callback is due */
+	int64_t next_event = timeval_ms() + polling_period;
+
 #ifndef _WIN32
 	if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
 		LOG_ERROR("couldn't set SIGPIPE to SIG_IGN");
 #endif
 
 	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
-		/* monitor sockets for activity */
-		fd_max = 0;
-		FD_ZERO(&read_fds);
-
-		/* add service and connection fds to read_fds */
-		for (service = services; service; service = service->next) {
-			if (service->fd != -1) {
-				/* listen for new connections */
-				FD_SET(service->fd, &read_fds);
-
-				if (service->fd > fd_max)
-					fd_max = service->fd;
-			}
-
-			if (service->connections) {
-				struct connection *c;
-
-				for (c = service->connections; c; c = c->next) {
-					/* check for activity on the connection */
-					FD_SET(c->fd, &read_fds);
-					if (c->fd > fd_max)
-						fd_max = c->fd;
-				}
-			}
-		}
-
-		struct timeval tv;
-		tv.tv_sec = 0;
 		if (poll_ok) {
 			/* we're just polling this iteration, this is faster on embedded
 			 * hosts */
-			tv.tv_usec = 0;
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = server_wait_fds(0);
 		} else {
-			/* Every 100ms, can be changed with "poll_period" command */
-			tv.tv_usec = polling_period * 1000;
+			/* Sleep until the next target timer callback is due, but at most
+			 * 100ms, can be changed with "poll_period" command */
+			int64_t timeout_ms = next_event - timeval_ms();
+			if (timeout_ms < 0)
+				timeout_ms = 0;
+			else if (timeout_ms > polling_period)
+				timeout_ms = polling_period;
+
 			/* Only while we're sleeping we'll let others run */
 			openocd_sleep_prelude();
 			kept_alive();
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = server_wait_fds(timeout_ms);
 			openocd_sleep_postlude();
 		}
 
@@ -495,18 +653,14 @@ int server_loop(struct command_context *command_context)
 
 			errno = WSAGetLastError();
 
-			if (errno == WSAEINTR)
-				FD_ZERO(&read_fds);
-			else {
+			if (errno != WSAEINTR) {
 				LOG_ERROR("error during select: %s", strerror(errno));
 				return ERROR_FAIL;
 			}
 #else
 
-			if (errno == EINTR)
-				FD_ZERO(&read_fds);
-			else {
-				LOG_ERROR("error during select: %s", strerror(errno));
+			if (errno != EINTR) {
+				LOG_ERROR("error waiting for input: %s", strerror(errno));
 				return ERROR_FAIL;
 			}
 #endif
@@ -516,10 +670,9 @@ int server_loop(struct command_context *command_context)
 			/* We only execute these callbacks when there was nothing to do or we timed
 			 *out */
 			target_call_timer_callbacks();
+			next_event = target_timer_next_event();
 			process_jim_events(command_context);
 
-			FD_ZERO(&read_fds);	/* eCos leaves read_fds unchanged in this case!  */
-
 			/* We timed out/there was nothing to do, timeout rather than poll next time
 			 **/
 			poll_ok = false;
@@ -537,8 +690,8 @@ int server_loop(struct command_context *command_context)
 
 		for (service = services; service; service = service->next) {
 			/* handle new connections on listeners */
-			if ((service->fd != -1)
-				&& (FD_ISSET(service->fd, &read_fds))) {
+			if ((service->fd != -1) && service->fd_ready) {
+				service->fd_ready = false;
 				if (service->max_connections != 0)
 					add_connection(service, command_context);
 				else {
@@ -562,8 +715,11 @@ int server_loop(struct command_context *command_context)
 				struct connection *c;
 
 				for (c = service->connections; c; ) {
-					if ((FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
+					if (c->fd_ready || c->input_pending) {
+						c->fd_ready = false;
+						int64_t start = timeval_us();
 						retval = service->input(c);
+						connection_stats_request(&c->stats, timeval_us() - start);
 						if (retval != ERROR_OK) {
 							struct connection *next = c->next;
 							if (service->type == CONNECTION_PIPE ||
@@ -584,6 +740,13 @@ int server_loop(struct command_context *command_context)
 			}
 		}
 
+		/* A busy connection must not starve the target timers, e.g. polling
+		 * and trace callbacks, so fire them as soon as they are due. */
+		if (poll_ok && timeval_ms() >= next_event) {
+			target_call_timer_callbacks();
+			next_event = target_timer_next_event();
+		}
+
 #ifdef _WIN32
 		MSG msg;
 		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
@@ -682,11 +845,65 @@ int server_init(struct command_context *cmd_ctx)
 	return ERROR_OK;
 }
 
+static void server_write_stats_file(void)
+{
+	FILE *f = fopen(stats_file_name, "w");
+	if (f == NULL) {
+		LOG_ERROR("couldn't open stats file '%s'", stats_file_name);
+		return;
+	}
+
+	fprintf(f, "{\n\t\"services\": [");
+	for (struct service *s = services; s; s = s->next) {
+		struct connection_stats stats = s->stats;
+		unsigned int connections = s->num_closed;
+		const char *sep = "";
+
+		for (struct connection *c = s->connections; c; c = c->next) {
+			connection_stats_add(&stats, &c->stats);
+			connections++;
+		}
+
+		fprintf(f, "%s\n\t\t{\"name\": \"%s\", \"port\": \"%s\", \"connections\": %u, "
+				"\"requests\": %" PRIu64 ", \"bytes_in\": %" PRIu64 ", \"bytes_out\": %" PRIu64 ", "
+				"\"handler_time_us\": %" PRId64 ", \"target_time_us\": %" PRId64 ",\n\t\t \"packets\": {",
+				s == services ? "" : ",", s->name, s->port, connections,
+				stats.requests, stats.bytes_in, stats.bytes_out,
+				stats.handler_time, stats.target_time);
+		for (unsigned int i = 0; i < ARRAY_SIZE(stats.packets); i++) {
+			if (stats.packets[i] == 0)
+				continue;
+			if (isalnum(i) || i == '?' || i == '!')
+				fprintf(f, "%s\"%c\": %" PRIu64, sep, i, stats.packets[i]);
+			else
+				fprintf(f, "%s\"\\u%04x\": %" PRIu64, sep, i, stats.packets[i]);
+			sep = ", ";
+		}
+		fprintf(f, "},\n\t\t \"histogram_us\": [");
+		for (unsigned int i = 0; i < CONNECTION_STATS_BUCKETS; i++)
+			fprintf(f, "%s%" PRIu64, i ? ", " : "", stats.histogram[i]);
+		fprintf(f, "]}");
+	}
+	fprintf(f, "\n\t]\n}\n");
+
+	fclose(f);
+}
+
 int server_quit(void)
 {
+	if (stats_file_name)
+		server_write_stats_file();
+
 	remove_services();
 	target_quit();
 
+#ifdef HAVE_SYS_EPOLL_H
+	if (epoll_fd != -1) {
+		close(epoll_fd);
+		epoll_fd = -1;
+	}
+#endif
+
 #ifdef _WIN32
 	WSACleanup();
 	SetConsoleCtrlHandler(ControlHandler, FALSE);
@@ -705,6 +922,7 @@ void server_free(void)
 	jsp_service_free();
 
 	free(bindto_name);
+	free(stats_file_name);
 }
 
 void exit_on_signal(int sig)
@@ -718,22 +936,36 @@ void exit_on_signal(int sig)
 
 int connection_write(struct connection *connection, const void *data, int len)
 {
+	int retval;
+
 	if (len == 0) {
 		/* successful no-op. Sockets and pipes behave differently here... */
 		return 0;
 	}
 	if (connection->service->type == CONNECTION_TCP)
-		return write_socket(connection->fd_out, data, len);
+		retval = write_socket(connection->fd_out, data, len);
 	else
-		return write(connection->fd_out, data, len);
+		retval = write(connection->fd_out, data, len);
+
+	if (retval > 0)
+		connection->stats.bytes_out += retval;
+
+	return retval;
 }
 
 int connection_read(struct connection *connection, void *data, int len)
 {
+	int retval;
+
 	if (connection->service->type == CONNECTION_TCP)
-		return read_socket(connection->fd, data, len);
+		retval = read_socket(connection->fd, data, len);
 	else
-		return read(connection->fd, data, len);
+		retval = read(connection->fd, data, len);
+
+	if (retval > 0)
+		connection->stats.bytes_in += retval;
+
+	return retval;
 }
 
 /* tell the server we want to shut down */
@@ -781,7 +1013,134 @@ COMMAND_HANDLER(handle_bindto_command)
 	return ERROR_OK;
 }
 
+static void server_print_stats(struct command_context *cmd_ctx,
+		const char *what, const struct connection_stats *stats)
+{
+	char line[128];
+	int len;
+
+	command_print(cmd_ctx, "%s: %" PRIu64 " requests, %" PRIu64 " bytes in, "
+			"%" PRIu64 " bytes out, %" PRId64 " us in handler, %" PRId64 " us on target",
+			what, stats->requests, stats->bytes_in, stats->bytes_out,
+			stats->handler_time, stats->target_time);
+
+	len = snprintf(line, sizeof(line), "  packets:");
+	for (unsigned int i = 0; i < ARRAY_SIZE(stats->packets); i++) {
+		if (stats->packets[i] == 0)
+			continue;
+		if (len > 100) {
+			command_print(cmd_ctx, "%s", line);
+			len = snprintf(line, sizeof(line), "          ");
+		}
+		len += snprintf(line + len, sizeof(line) - len, isgraph(i) ? " %c:%" PRIu64 : " 0x%02x:%" PRIu64,
+				i, stats->packets[i]);
+	}
+	if (len > 10)
+		command_print(cmd_ctx, "%s", line);
+
+	len = snprintf(line, sizeof(line), "  service time:");
+	for (unsigned int i = 0; i < CONNECTION_STATS_BUCKETS; i++) {
+		if (stats->histogram[i] == 0)
+			continue;
+		if (len > 100) {
+			command_print(cmd_ctx, "%s", line);
+			len = snprintf(line, sizeof(line), "               ");
+		}
+		if (i == CONNECTION_STATS_BUCKETS - 1)
+			len += snprintf(line + len, sizeof(line) - len, " >=%lldus:%" PRIu64,
+					1LL << (i - 1), stats->histogram[i]);
+		else
+			len += snprintf(line + len, sizeof(line) - len, " <%lldus:%" PRIu64,
+					1LL << i, stats->histogram[i]);
+	}
+	if (len > 15)
+		command_print(cmd_ctx, "%s", line);
+}
+
+COMMAND_HANDLER(handle_server_stats_command)
+{
+	bool reset = false;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		reset = true;
+	}
+
+	for (struct service *s = services; s; s = s->next) {
+		if (reset) {
+			memset(&s->stats, 0, sizeof(s->stats));
+			s->num_closed = 0;
+			for (struct connection *c = s->connections; c; c = c->next)
+				memset(&c->stats, 0, sizeof(c->stats));
+			continue;
+		}
+
+		char what[64];
+		struct connection_stats stats = s->stats;
+		unsigned int n = 0;
+
+		for (struct connection *c = s->connections; c; c = c->next) {
+			snprintf(what, sizeof(what), "  connection %u", n++);
+			server_print_stats(CMD_CTX, what, &c->stats);
+			connection_stats_add(&stats, &c->stats);
+		}
+
+		snprintf(what, sizeof(what), "%s (port %s), %u connections",
+				s->name, s->port, s->num_closed + n);
+		server_print_stats(CMD_CTX, what, &stats);
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_server_stats_file_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		free(stats_file_name);
+		stats_file_name = NULL;
+		if (CMD_ARGV[0][0])
+			stats_file_name = strdup(CMD_ARGV[0]);
+	}
+
+	command_print(CMD_CTX, "stats file: %s", stats_file_name ? stats_file_name : "none");
+
+	return ERROR_OK;
+}
+
+static const struct command_registration server_subcommand_handlers[] = {
+	{
+		.name = "stats",
+		.handler = &handle_server_stats_command,
+		.mode = COMMAND_ANY,
+		.usage = "['reset']",
+		.help = "show the request, byte and service time statistics "
+			"of all services and their connections, or clear them",
+	},
+	{
+		.name = "stats_file",
+		.handler = &handle_server_stats_file_command,
+		.mode = COMMAND_ANY,
+		.usage = "[filename]",
+		.help = "write the statistics as JSON to the file on exit, "
+			"an empty name disables it",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration server_command_handlers[] = {
+	{
+		.name = "server",
+		.mode = COMMAND_ANY,
+		.help = "server statistics",
+		.usage = "",
+		.chain = server_subcommand_handlers,
+	},
 	{
 		.name = "shutdown",
 		.handler = &handle_shutdown_command,
@@ -43,6 +43,26 @@ enum connection_type {
 
 #define CONNECTION_LIMIT_UNLIMITED		(-1)
 
+/* number of log2 buckets of the service time histogram */
+#define CONNECTION_STATS_BUCKETS		24
+
+/* performance counters of a connection, reported by "server stats" */
+struct connection_stats {
+	/* calls of the input handler of the service */
+	uint64_t requests;
+	/* protocol packets, indexed by their first character (gdb only) */
+	uint64_t packets[128];
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	/* time spent in the input handler, in us */
+	int64_t handler_time;
+	/* part of handler_time spent accessing the target, in us */
+	int64_t target_time;
+	/* bucket n counts requests served in less than 2^n us,
+	 * the last one also counts all slower requests */
+	uint64_t histogram[CONNECTION_STATS_BUCKETS];
+};
+
 struct connection {
 	int fd;
 	int fd_out;	/* When using pipes we're writing to a different fd */
@@ -50,6 +70,9 @@ struct connection {
 	struct command_context *cmd_ctx;
 	struct service *service;
 	int input_pending;
+	/* set by the event loop when fd has data to read */
+	bool fd_ready;
+	struct connection_stats stats;
 	void *priv;
 	struct connection *next;
 };
@@ -64,9 +87,14 @@ struct service {
 	char *port;
 	unsigned short portnumber;
 	int fd;
+	/* set by the event loop when fd has a pending connection */
+	bool fd_ready;
 	struct sockaddr_in sin;
 	int max_connections;
 	struct connection *connections;
+	/* statistics of the closed connections */
+	struct connection_stats stats;
+	unsigned int num_closed;
 	new_connection_handler_t new_connection;
 	input_handler_t input;
 	connection_closed_handler_t connection_closed;
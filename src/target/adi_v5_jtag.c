@@ -356,6 +356,7 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 {
 	int retval;
 	struct dap_cmd *el, *tmp, *prev = NULL;
+	struct dap_cmd *last_ap = NULL;
 	int found_wait = 0;
 	int64_t time_now;
 	LIST_HEAD(replay_list);
@@ -369,8 +370,12 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 	list_for_each_entry(el, &dap->cmd_journal, lh) {
 		if (el->ack == JTAG_ACK_OK_FAULT) {
 			log_dap_cmd("LOG", el);
+			if (el->instr == JTAG_DP_APACC)
+				last_ap = el;
 		} else if (el->ack == JTAG_ACK_WAIT) {
 			found_wait = 1;
+			/* a stalled RDBUFF read waits for the selected AP as well */
+			mem_ap_memaccess_wait(&dap->ap[el->dp_select >> 24]);
 			break;
 		} else {
 			LOG_ERROR("Invalid ACK (%1x) in DAP response", el->ack);
@@ -380,6 +385,9 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 		}
 	}
 
+	if (!found_wait && last_ap)
+		mem_ap_memaccess_ok(&dap->ap[last_ap->dp_select >> 24]);
+
 	/*
 	 * If we found a stalled transaction and a previous transaction
 	 * exists, check if it's a READ access.
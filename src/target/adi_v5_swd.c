@@ -61,6 +61,7 @@ static void swd_finish_read(struct adiv5_dap *dap)
 	if (dap->last_read != NULL) {
 		swd->read_reg(swd_cmd(true, false, DP_RDBUFF), dap->last_read, 0);
 		dap->last_read = NULL;
+		dap->stats.rdbuff_reads++;
 	}
 }
 
@@ -176,16 +177,13 @@ static int swd_queue_dp_bankselect(struct adiv5_dap *dap, unsigned reg)
 	uint32_t sel = select_dp_bank
 			| (dap->select & (DP_SELECT_APSEL | DP_SELECT_APBANK));
 
-	if (sel == dap->select)
+	if (sel == dap->select) {
+		dap->stats.select_skipped++;
 		return ERROR_OK;
+	}
 
-	dap->select = sel;
-
-	int retval = swd_queue_dp_write(dap, DP_SELECT, sel);
-	if (retval != ERROR_OK)
-		dap->select = DP_SELECT_INVALID;
-
-	return retval;
+	/* swd_queue_dp_write() updates the cached value */
+	return swd_queue_dp_write(dap, DP_SELECT, sel);
 }
 
 static int swd_queue_dp_read(struct adiv5_dap *dap, unsigned reg,
@@ -217,8 +215,15 @@ static int swd_queue_dp_write(struct adiv5_dap *dap, unsigned reg,
 	if (retval != ERROR_OK)
 		return retval;
 
-	swd_finish_read(dap);
 	if (reg == DP_SELECT) {
+		/* same value as cached: neither the write nor the completion of a
+		 * posted read is needed, the read chain can go on */
+		if (data == dap->select) {
+			dap->stats.select_skipped++;
+			return ERROR_OK;
+		}
+
+		swd_finish_read(dap);
 		dap->select = data & (DP_SELECT_APSEL | DP_SELECT_APBANK | DP_SELECT_DPBANK);
 
 		swd->write_reg(swd_cmd(false,  false, reg), data, 0);
@@ -230,6 +235,7 @@ static int swd_queue_dp_write(struct adiv5_dap *dap, unsigned reg,
 		return retval;
 	}
 
+	swd_finish_read(dap);
 	retval = swd_queue_dp_bankselect(dap, reg);
 	if (retval != ERROR_OK)
 		return retval;
@@ -247,16 +253,13 @@ static int swd_queue_ap_bankselect(struct adiv5_ap *ap, unsigned reg)
 			| (reg & 0x000000F0)
 			| (dap->select & DP_SELECT_DPBANK);
 
-	if (sel == dap->select)
+	if (sel == dap->select) {
+		dap->stats.select_skipped++;
 		return ERROR_OK;
+	}
 
-	dap->select = sel;
-
-	int retval = swd_queue_dp_write(dap, DP_SELECT, sel);
-	if (retval != ERROR_OK)
-		dap->select = DP_SELECT_INVALID;
-
-	return retval;
+	/* swd_queue_dp_write() updates the cached value */
+	return swd_queue_dp_write(dap, DP_SELECT, sel);
 }
 
 static int swd_queue_ap_read(struct adiv5_ap *ap, unsigned reg,
@@ -274,6 +277,9 @@ static int swd_queue_ap_read(struct adiv5_ap *ap, unsigned reg,
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* the read returns the result of the previous posted read, if any */
+	if (dap->last_read)
+		dap->stats.chained_reads++;
 	swd->read_reg(swd_cmd(true,  true, reg), dap->last_read, ap->memaccess_tck);
 	dap->last_read = data;
 
@@ -109,6 +109,8 @@ static int mem_ap_setup_csw(struct adiv5_ap *ap, uint32_t csw)
 			return retval;
 		}
 		ap->csw_value = csw;
+	} else {
+		ap->dap->stats.csw_skipped++;
 	}
 	return ERROR_OK;
 }
@@ -124,6 +126,8 @@ static int mem_ap_setup_tar(struct adiv5_ap *ap, uint32_t tar)
 		}
 		ap->tar_value = tar;
 		ap->tar_valid = true;
+	} else {
+		ap->dap->stats.tar_skipped++;
 	}
 	return ERROR_OK;
 }
@@ -790,6 +794,43 @@ int mem_ap_init(struct adiv5_ap *ap)
 	return ERROR_OK;
 }
 
+/* number of queue runs without WAIT before an adapted memaccess_tck is lowered */
+#define MEMACCESS_RELAX_RUNS 64
+
+/**
+ * Called when a transaction on the AP got a WAIT response. With automatic
+ * tuning enabled, the delay is raised quickly: doubled, starting at 8 tck.
+ */
+void mem_ap_memaccess_wait(struct adiv5_ap *ap)
+{
+	ap->memaccess_waits++;
+	ap->memaccess_clean_runs = 0;
+
+	if (!ap->memaccess_auto || ap->memaccess_tck >= 255)
+		return;
+
+	ap->memaccess_tck = ap->memaccess_tck ? MIN(2 * ap->memaccess_tck, 255u) : 8;
+	LOG_DEBUG("AP %d: memory bus access delay raised to %" PRIu32 " tck",
+			ap->ap_num, ap->memaccess_tck);
+}
+
+/**
+ * Called after a queue run with accesses to the AP completed without WAIT.
+ * The delay is lowered one tck at a time, after a long enough quiet period,
+ * down to the value it was when tuning was enabled.
+ */
+void mem_ap_memaccess_ok(struct adiv5_ap *ap)
+{
+	if (!ap->memaccess_auto || ap->memaccess_tck <= ap->memaccess_tck_min)
+		return;
+
+	if (++ap->memaccess_clean_runs < MEMACCESS_RELAX_RUNS)
+		return;
+
+	ap->memaccess_clean_runs = 0;
+	ap->memaccess_tck--;
+}
+
 /**
  * Put the debug link into SWD mode, if the target supports it.
  * The link's initial mode may be either JTAG (for example,
@@ -1689,22 +1730,35 @@ COMMAND_HANDLER(dap_baseaddr_command)
 COMMAND_HANDLER(dap_memaccess_command)
 {
 	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+	struct adiv5_ap *ap = &dap->ap[dap->apsel];
 	uint32_t memaccess_tck;
 
 	switch (CMD_ARGC) {
 	case 0:
-		memaccess_tck = dap->ap[dap->apsel].memaccess_tck;
 		break;
 	case 1:
+		if (strcmp(CMD_ARGV[0], "auto") == 0) {
+			/* the current value becomes the lower limit */
+			ap->memaccess_auto = true;
+			ap->memaccess_tck_min = ap->memaccess_tck;
+			ap->memaccess_clean_runs = 0;
+			break;
+		}
 		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], memaccess_tck);
+		ap->memaccess_tck = memaccess_tck;
+		ap->memaccess_auto = false;
 		break;
 	default:
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
-	dap->ap[dap->apsel].memaccess_tck = memaccess_tck;
 
-	command_print(CMD_CTX, "memory bus access delay set to %" PRIi32 " tck",
-			dap->ap[dap->apsel].memaccess_tck);
+	if (ap->memaccess_auto)
+		command_print(CMD_CTX, "memory bus access delay set to %" PRIi32 " tck "
+				"(auto, minimum %" PRIu32 ", %" PRIu32 " WAIT responses)",
+				ap->memaccess_tck, ap->memaccess_tck_min, ap->memaccess_waits);
+	else
+		command_print(CMD_CTX, "memory bus access delay set to %" PRIi32 " tck",
+				ap->memaccess_tck);
 
 	return ERROR_OK;
 }
@@ -1912,6 +1966,37 @@ COMMAND_HANDLER(dap_ti_be_32_quirks_command)
 	return 0;
 }
 
+COMMAND_HANDLER(dap_stats_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+	struct adiv5_dap_stats *stats = &dap->stats;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+		return ERROR_OK;
+	}
+
+	uint64_t avoided = stats->chained_reads + stats->select_skipped
+		+ stats->csw_skipped + stats->tar_skipped;
+
+	command_print(CMD_CTX, "DP reads:  %" PRIu64 ", of which RDBUFF for posted AP reads: %" PRIu64,
+		stats->dp_reads + stats->rdbuff_reads, stats->rdbuff_reads);
+	command_print(CMD_CTX, "DP writes: %" PRIu64, stats->dp_writes);
+	command_print(CMD_CTX, "AP reads:  %" PRIu64 ", of which chained: %" PRIu64,
+		stats->ap_reads, stats->chained_reads);
+	command_print(CMD_CTX, "AP writes: %" PRIu64, stats->ap_writes);
+	command_print(CMD_CTX, "avoided:   %" PRIu64 " (RDBUFF %" PRIu64 ", SELECT %" PRIu64
+		", CSW %" PRIu64 ", TAR %" PRIu64 ")", avoided, stats->chained_reads,
+		stats->select_skipped, stats->csw_skipped, stats->tar_skipped);
+
+	return ERROR_OK;
+}
+
 const struct command_registration dap_instance_commands[] = {
 	{
 		.name = "info",
@@ -1974,8 +2059,16 @@ const struct command_registration dap_instance_commands[] = {
 		.handler = dap_memaccess_command,
 		.mode = COMMAND_EXEC,
 		.help = "set/get number of extra tck for MEM-AP memory "
-			"bus access [0-255]",
-		.usage = "[cycles]",
+			"bus access [0-255], or adapt it to WAIT responses",
+		.usage = "[cycles|'auto']",
+	},
+	{
+		.name = "stats",
+		.handler = dap_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "display or reset the counts of queued and avoided "
+			"DAP transactions",
+		.usage = "[reset]",
 	},
 	{
 		.name = "ti_be_32_quirks",
@@ -179,6 +179,15 @@ struct adiv5_ap {
 	 */
 	uint32_t memaccess_tck;
 
+	/* adapt memaccess_tck to the WAIT responses, see "dap memaccess auto" */
+	bool memaccess_auto;
+	/* lower limit of the adapted memaccess_tck */
+	uint32_t memaccess_tck_min;
+	/* queue runs without WAIT since memaccess_tck was last changed */
+	uint32_t memaccess_clean_runs;
+	/* WAIT responses seen on this AP */
+	uint32_t memaccess_waits;
+
 	/* Size of TAR autoincrement block, ARM ADI Specification requires at least 10 bits */
 	uint32_t tar_autoincr_block;
 
@@ -193,6 +202,26 @@ struct adiv5_ap {
 };
 
 
+/**
+ * Counters of the transactions queued on a DAP and of the ones the
+ * transport and MEM-AP caches avoided, see "dap stats".
+ */
+struct adiv5_dap_stats {
+	uint64_t dp_reads;
+	uint64_t dp_writes;
+	uint64_t ap_reads;
+	uint64_t ap_writes;
+	/** DP RDBUFF reads issued to complete a posted AP read */
+	uint64_t rdbuff_reads;
+	/** posted AP reads completed by the next AP read instead of RDBUFF */
+	uint64_t chained_reads;
+	/** DP SELECT writes skipped because the cached value matched */
+	uint64_t select_skipped;
+	/** MEM-AP CSW and TAR writes skipped because the cached value matched */
+	uint64_t csw_skipped;
+	uint64_t tar_skipped;
+};
+
 /**
  * This represents an ARM Debug Interface (v5) Debug Access Port (DAP).
  * A DAP has two types of component:  one Debug Port (DP), which is a
@@ -254,6 +283,8 @@ struct adiv5_dap {
 	/** Flag saying whether to ignore the syspwrupack flag in DAP. Some devices
 	 *  do not set this bit until later in the bringup sequence */
 	bool ignore_syspwrupack;
+
+	struct adiv5_dap_stats stats;
 };
 
 /**
@@ -328,6 +359,7 @@ static inline int dap_queue_dp_read(struct adiv5_dap *dap,
 		unsigned reg, uint32_t *data)
 {
 	assert(dap->ops != NULL);
+	dap->stats.dp_reads++;
 	return dap->ops->queue_dp_read(dap, reg, data);
 }
 
@@ -346,6 +378,7 @@ static inline int dap_queue_dp_write(struct adiv5_dap *dap,
 		unsigned reg, uint32_t data)
 {
 	assert(dap->ops != NULL);
+	dap->stats.dp_writes++;
 	return dap->ops->queue_dp_write(dap, reg, data);
 }
 
@@ -363,6 +396,7 @@ static inline int dap_queue_ap_read(struct adiv5_ap *ap,
 		unsigned reg, uint32_t *data)
 {
 	assert(ap->dap->ops != NULL);
+	ap->dap->stats.ap_reads++;
 	return ap->dap->ops->queue_ap_read(ap, reg, data);
 }
 
@@ -379,6 +413,7 @@ static inline int dap_queue_ap_write(struct adiv5_ap *ap,
 		unsigned reg, uint32_t data)
 {
 	assert(ap->dap->ops != NULL);
+	ap->dap->stats.ap_writes++;
 	return ap->dap->ops->queue_ap_write(ap, reg, data);
 }
 
@@ -492,6 +527,10 @@ int mem_ap_write_buf_noincr(struct adiv5_ap *ap,
 int dap_dp_init(struct adiv5_dap *dap);
 int mem_ap_init(struct adiv5_ap *ap);
 
+/* Feedback from the transport for the adaptive memaccess_tck */
+void mem_ap_memaccess_wait(struct adiv5_ap *ap);
+void mem_ap_memaccess_ok(struct adiv5_ap *ap);
+
 /* Invalidate cached DP select and cached TAR and CSW of all APs */
 void dap_invalidate_cache(struct adiv5_dap *dap);
 
@@ -29,6 +29,7 @@
 #include "helper/command.h"
 #include "transport/transport.h"
 #include "jtag/interface.h"
+#include "jtag/swd.h"
 
 static LIST_HEAD(all_dap);
 
@@ -117,7 +118,7 @@ static int dap_init_all(void)
 
 		if (transport_is_swd()) {
 			dap->ops = &swd_dap_ops;
-			obj->swd = jtag_interface->swd;
+			obj->swd = swd_trace_driver(jtag_interface->swd);
 		} else
 			dap->ops = &jtag_dp_ops;
 
@@ -393,6 +393,155 @@ static int cortex_m_examine_exception_reason(struct target *target)
 	return retval;
 }
 
+static int cortex_m_queue_reg_read(struct adiv5_ap *ap, uint32_t regsel,
+		uint32_t *dhcsr, uint32_t *value)
+{
+	int retval = mem_ap_write_u32(ap, DCB_DCRSR, regsel);
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_u32(ap, DCB_DHCSR, dhcsr);
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_u32(ap, DCB_DCRDR, value);
+	return retval;
+}
+
+/* Reads the invalid core registers among reg_list with a single DAP run.
+ * Every DCRSR write is followed by a DHCSR read, which gives the core the
+ * time to complete the transfer, and the DCRDR read. S_REGRDY of all DHCSR
+ * values is checked afterwards; if any transfer didn't complete, the
+ * registers are left invalid and have to be read one by one. */
+static int cortex_m_fast_read_regs(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct reg_cache *cache = armv7m->arm.core_cache;
+	int slot[ARMV7M_LAST_REG];
+	uint32_t dhcsr[2 * ARMV7M_LAST_REG];
+	uint32_t value[2 * ARMV7M_LAST_REG];
+	int special = -1;
+	int count = 0;
+	int retval = ERROR_OK;
+	int i;
+
+	/* DCRDR is shared with the emulated DCC channel, which needs
+	 * it saved and restored around each access */
+	if (target->dbg_msg_enabled)
+		return ERROR_OK;
+
+	for (i = 0; i < ARMV7M_LAST_REG; i++)
+		slot[i] = -1;
+
+	for (i = 0; i < reg_list_size && retval == ERROR_OK; i++) {
+		struct reg *r = reg_list[i];
+		if (r == NULL || r < cache->reg_list || r >= cache->reg_list + cache->num_regs)
+			continue;
+		if (r->valid || !r->exist)
+			continue;
+
+		struct arm_reg *arm_reg = r->arch_info;
+		int num = arm_reg->num;
+		if (slot[num] >= 0)
+			continue;
+
+		if (num <= ARMV7M_PSP) {
+			slot[num] = count;
+			retval = cortex_m_queue_reg_read(armv7m->debug_ap, num,
+					&dhcsr[count], &value[count]);
+			count++;
+		} else if (num >= ARMV7M_PRIMASK && num <= ARMV7M_CONTROL) {
+			/* packed into one debug core register */
+			if (special < 0) {
+				special = count;
+				retval = cortex_m_queue_reg_read(armv7m->debug_ap, 20,
+						&dhcsr[count], &value[count]);
+				count++;
+			}
+			slot[num] = special;
+		} else if (num >= ARMV7M_S0 && num <= ARMV7M_S31) {
+			slot[num] = count;
+			retval = cortex_m_queue_reg_read(armv7m->debug_ap, num - ARMV7M_S0 + 0x40,
+					&dhcsr[count], &value[count]);
+			count++;
+		} else if (num >= ARMV7M_D0 && num <= ARMV7M_D15) {
+			/* D0..D15 map to S0..S31 */
+			slot[num] = count;
+			retval = cortex_m_queue_reg_read(armv7m->debug_ap, 2 * (num - ARMV7M_D0) + 0x40,
+					&dhcsr[count], &value[count]);
+			count++;
+			if (retval == ERROR_OK)
+				retval = cortex_m_queue_reg_read(armv7m->debug_ap, 2 * (num - ARMV7M_D0) + 0x41,
+						&dhcsr[count], &value[count]);
+			count++;
+		} else if (num == ARMV7M_FPSCR) {
+			slot[num] = count;
+			retval = cortex_m_queue_reg_read(armv7m->debug_ap, 0x21,
+					&dhcsr[count], &value[count]);
+			count++;
+		}
+	}
+
+	if (count == 0)
+		return retval;
+
+	/* run the queue even if queueing failed part way, no read may be left
+	 * in it pointing into this stack frame */
+	int run_retval = dap_run(armv7m->debug_ap->dap);
+	if (retval == ERROR_OK)
+		retval = run_retval;
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (i = 0; i < count; i++) {
+		if (!(dhcsr[i] & S_REGRDY)) {
+			LOG_DEBUG("core register transfer not ready, reading registers one by one");
+			return ERROR_FAIL;
+		}
+	}
+
+	for (i = 0; i < reg_list_size; i++) {
+		struct reg *r = reg_list[i];
+		if (r == NULL || r < cache->reg_list || r >= cache->reg_list + cache->num_regs)
+			continue;
+
+		struct arm_reg *arm_reg = r->arch_info;
+		int num = arm_reg->num;
+		if (slot[num] < 0 || r->valid)
+			continue;
+
+		uint32_t v = value[slot[num]];
+		switch (num) {
+			case ARMV7M_PRIMASK:
+				v &= 1;
+				break;
+			case ARMV7M_BASEPRI:
+				v = (v >> 8) & 0xff;
+				break;
+			case ARMV7M_FAULTMASK:
+				v = (v >> 16) & 1;
+				break;
+			case ARMV7M_CONTROL:
+				v = (v >> 24) & 3;
+				break;
+		}
+
+		buf_set_u32(r->value, 0, 32, v);
+		if (num >= ARMV7M_D0 && num <= ARMV7M_D15)
+			buf_set_u32(r->value + 4, 0, 32, value[slot[num] + 1]);
+		r->valid = true;
+		r->dirty = false;
+	}
+
+	return ERROR_OK;
+}
+
+static int cortex_m_read_registers(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	if (target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	return cortex_m_fast_read_regs(target, reg_list, reg_list_size);
+}
+
 static int cortex_m_debug_entry(struct target *target)
 {
 	int i;
@@ -418,6 +567,16 @@ static int cortex_m_debug_entry(struct target *target)
 	 * First load register accessible through core debug port */
 	int num_regs = arm->core_cache->num_regs;
 
+	/* try to fetch all of them in one go, whatever is left invalid
+	 * is read one by one below */
+	struct reg **regs = malloc(num_regs * sizeof(struct reg *));
+	if (regs) {
+		for (i = 0; i < num_regs; i++)
+			regs[i] = &arm->core_cache->reg_list[i];
+		cortex_m_fast_read_regs(target, regs, num_regs);
+		free(regs);
+	}
+
 	for (i = 0; i < num_regs; i++) {
 		r = &armv7m->arm.core_cache->reg_list[i];
 		if (!r->valid)
@@ -2519,6 +2678,7 @@ struct target_type cortexm_target = {
 
 	.get_gdb_arch = arm_get_gdb_arch,
 	.get_gdb_reg_list = armv7m_get_gdb_reg_list,
+	.read_registers = cortex_m_read_registers,
 
 	.read_memory = cortex_m_read_memory,
 	.write_memory = cortex_m_write_memory,
@@ -74,6 +74,10 @@ static int target_gdb_fileio_end_default(struct target *target, int retcode,
 		int fileio_errno, bool ctrl_c);
 static int target_profiling_default(struct target *target, uint32_t *samples,
 		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
+static void target_invalidate_loaders(struct target *target,
+		target_addr_t address, target_addr_t size);
+static void target_forget_loaders(struct target *target);
+static bool target_release_loaders(struct target *target);
 
 /* targets */
 extern struct target_type arm7tdmi_target;
@@ -154,6 +158,9 @@ static struct target_type *target_types[] = {
 struct target *all_targets;
 static struct target_event_callback *target_event_callbacks;
 static struct target_timer_callback *target_timer_callbacks;
+static int64_t target_timer_next_event_value;
+/* incremented whenever target state or memory may have changed */
+static uint32_t target_generation;
 LIST_HEAD(target_reset_callback_list);
 LIST_HEAD(target_trace_callback_list);
 static const int polling_interval = 100;
@@ -549,6 +556,11 @@ int target_poll(struct target *target)
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* running code or a reset we didn't ask for may have overwritten
+	 * the loaders kept in working areas */
+	if (target->state == TARGET_RUNNING || target->state == TARGET_RESET)
+		target_forget_loaders(target);
+
 	if (target->halt_issued) {
 		if (target->state == TARGET_HALTED)
 			target->halt_issued = false;
@@ -627,6 +639,11 @@ int target_resume(struct target *target, int current, target_addr_t address,
 
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_START);
 
+	/* not all targets free their working areas on resume, the code
+	 * about to run may overwrite the loaders kept there */
+	if (!debug_execution)
+		target_release_loaders(target);
+
 	/* note that resume *must* be asynchronous. The CPU can halt before
 	 * we poll. The CPU can even halt at the current PC as a result of
 	 * a software breakpoint being inserted by (a bug?) the application.
@@ -811,6 +828,7 @@ int target_run_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_generation++;
 	target->running_alg = true;
 	retval = target->type->run_algorithm(target,
 			num_mem_params, mem_params,
@@ -845,6 +863,7 @@ int target_start_algorithm(struct target *target,
 				target_type_name(target), __func__);
 		goto done;
 	}
+	target_generation++;
 	if (target->running_alg) {
 		LOG_ERROR("Target is already running an algorithm");
 		goto done;
@@ -1125,6 +1144,8 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_generation++;
+	target_invalidate_loaders(target, address, (target_addr_t)size * count);
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1139,6 +1160,8 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_generation++;
+	target_invalidate_loaders(target, address, (target_addr_t)size * count);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1224,6 +1247,15 @@ int target_get_gdb_reg_list(struct target *target,
 	return target->type->get_gdb_reg_list(target, reg_list, reg_list_size, reg_class);
 }
 
+int target_read_registers(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	if (target->type->read_registers == NULL)
+		return ERROR_OK;
+
+	return target->type->read_registers(target, reg_list, reg_list_size);
+}
+
 bool target_supports_gdb_connection(struct target *target)
 {
 	/*
@@ -1236,6 +1268,8 @@ bool target_supports_gdb_connection(struct target *target)
 int target_step(struct target *target,
 		int current, target_addr_t address, int handle_breakpoints)
 {
+	target_generation++;
+	target_forget_loaders(target);
 	return target->type->step(target, current, address, handle_breakpoints);
 }
 
@@ -1503,6 +1537,11 @@ int target_register_timer_callback(int (*callback)(void *priv),
 	(*callbacks_p)->priv = priv;
 	(*callbacks_p)->next = NULL;
 
+	int64_t when_ms = (int64_t)(*callbacks_p)->when.tv_sec * 1000 +
+		(*callbacks_p)->when.tv_usec / 1000;
+	if (when_ms < target_timer_next_event_value)
+		target_timer_next_event_value = when_ms;
+
 	return ERROR_OK;
 }
 
@@ -1596,6 +1635,9 @@ int target_call_event_callbacks(struct target *target, enum target_event event)
 	LOG_DEBUG("target event %i (%s)", event,
 			Jim_Nvp_value2name_simple(nvp_target_event, event)->name);
 
+	/* resume, halt, reset, ... anything could have changed */
+	target_generation++;
+
 	target_handle_event(target, event);
 
 	while (callback) {
@@ -1614,6 +1656,9 @@ int target_call_reset_callbacks(struct target *target, enum target_reset_mode re
 	LOG_DEBUG("target reset %i (%s)", reset_mode,
 			Jim_Nvp_value2name_simple(nvp_reset_modes, reset_mode)->name);
 
+	/* the working area RAM doesn't survive a reset that runs code */
+	target_forget_loaders(target);
+
 	list_for_each_entry(callback, &target_reset_callback_list, list)
 		callback->callback(target, reset_mode, callback->priv);
 
@@ -1664,6 +1709,11 @@ static int target_call_timer_callbacks_check_time(int checktime)
 	struct timeval now;
 	gettimeofday(&now, NULL);
 
+	/* Initialize to a default value that's a ways into the future.
+	 * The loop below will make it closer to now if there are
+	 * callbacks that want to be called sooner. */
+	target_timer_next_event_value = timeval_ms() + 1000 * 60 * 60 * 24 * 7;
+
 	/* Store an address of the place containing a pointer to the
 	 * next item; initially, that's a standalone "root of the
 	 * list" variable. */
@@ -1683,6 +1733,13 @@ static int target_call_timer_callbacks_check_time(int checktime)
 		if (call_it)
 			target_call_timer_callback(*callback, &now);
 
+		if (!(*callback)->removed) {
+			int64_t when_ms = (int64_t)(*callback)->when.tv_sec * 1000 +
+				(*callback)->when.tv_usec / 1000;
+			if (when_ms < target_timer_next_event_value)
+				target_timer_next_event_value = when_ms;
+		}
+
 		callback = &(*callback)->next;
 	}
 
@@ -1701,14 +1758,26 @@ int target_call_timer_callbacks_now(void)
 	return target_call_timer_callbacks_check_time(0);
 }
 
+uint32_t target_get_generation(void)
+{
+	return target_generation;
+}
+
+/* Returns when the next registered timer callback is due, in the same
+ * time base as timeval_ms() */
+int64_t target_timer_next_event(void)
+{
+	return target_timer_next_event_value;
+}
+
 /* Prints the working area layout for debug purposes */
 static void print_wa_layout(struct target *target)
 {
 	struct working_area *c = target->working_areas;
 
 	while (c) {
-		LOG_DEBUG("%c%c " TARGET_ADDR_FMT "-" TARGET_ADDR_FMT " (%" PRIu32 " bytes)",
-			c->backup ? 'b' : ' ', c->free ? ' ' : '*',
+		LOG_DEBUG("%c%c%c " TARGET_ADDR_FMT "-" TARGET_ADDR_FMT " (%" PRIu32 " bytes)",
+			c->backup ? 'b' : ' ', c->free ? ' ' : '*', c->loader ? 'l' : ' ',
 			c->address, c->address + c->size - 1, c->size);
 		c = c->next;
 	}
@@ -1733,6 +1802,7 @@ static void target_split_working_area(struct working_area *area, uint32_t size)
 		new_wa->backup = NULL;
 		new_wa->user = NULL;
 		new_wa->free = true;
+		new_wa->loader = NULL;
 
 		area->next = new_wa;
 		area->size = size;
@@ -1778,6 +1848,93 @@ static void target_merge_working_areas(struct target *target)
 	}
 }
 
+/* Find the first large enough free working area */
+static struct working_area *target_find_free_working_area(struct target *target, uint32_t size)
+{
+	struct working_area *c = target->working_areas;
+
+	while (c) {
+		if (c->free && c->size >= size)
+			break;
+		c = c->next;
+	}
+
+	return c;
+}
+
+static int target_restore_working_area(struct target *target, struct working_area *area);
+
+/* Forget the code held by a resident loader, returning the area to the
+ * allocation pool unless somebody is using it right now */
+static void target_drop_loader(struct target *target, struct working_area *area,
+		int restore)
+{
+	LOG_DEBUG("dropping resident loader at address " TARGET_ADDR_FMT, area->address);
+
+	free(area->loader);
+	area->loader = NULL;
+
+	if (area->user == NULL) {
+		if (restore)
+			target_restore_working_area(target, area);
+		area->free = true;
+	}
+}
+
+/* Free all loaders not in use, returns true if any space was released */
+static bool target_release_loaders(struct target *target)
+{
+	bool released = false;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->loader && c->user == NULL) {
+			target_drop_loader(target, c, 1);
+			released = true;
+		}
+	}
+
+	if (released)
+		target_merge_working_areas(target);
+
+	return released;
+}
+
+/* Drop all loaders when the target may have changed their memory, e.g.
+ * after a reset or while running. The memory isn't restored, it's no
+ * longer known to hold the loader code. */
+static void target_forget_loaders(struct target *target)
+{
+	bool released = false;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->loader) {
+			released |= (c->user == NULL);
+			target_drop_loader(target, c, 0);
+		}
+	}
+
+	if (released)
+		target_merge_working_areas(target);
+}
+
+/* Drop the loaders overwritten by a write of size bytes at address */
+static void target_invalidate_loaders(struct target *target,
+		target_addr_t address, target_addr_t size)
+{
+	bool released = false;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->loader && address < c->address + c->size
+				&& c->address < address + size) {
+			released |= (c->user == NULL);
+			target_drop_loader(target, c, 1);
+		}
+	}
+
+	if (released)
+		target_merge_working_areas(target);
+}
+
 int target_alloc_working_area_try(struct target *target, uint32_t size, struct working_area **area)
 {
 	/* Reevaluate working area address based on MMU state*/
@@ -1822,6 +1979,7 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 			new_wa->backup = NULL;
 			new_wa->user = NULL;
 			new_wa->free = true;
+			new_wa->loader = NULL;
 		}
 
 		target->working_areas = new_wa;
@@ -1831,14 +1989,11 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	if (size % 4)
 		size = (size + 3) & (~3UL);
 
-	struct working_area *c = target->working_areas;
+	struct working_area *c = target_find_free_working_area(target, size);
 
-	/* Find the first large enough working area */
-	while (c) {
-		if (c->free && c->size >= size)
-			break;
-		c = c->next;
-	}
+	/* Make room by dropping the loaders nobody is using right now */
+	if (c == NULL && target_release_loaders(target))
+		c = target_find_free_working_area(target, size);
 
 	if (c == NULL)
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
@@ -1884,6 +2039,47 @@ int target_alloc_working_area(struct target *target, uint32_t size, struct worki
 
 }
 
+int target_alloc_loader(struct target *target, const uint8_t *code,
+		uint32_t size, struct working_area **area)
+{
+	uint32_t crc;
+	int retval;
+
+	retval = image_calculate_checksum((uint8_t *)code, size, &crc);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->loader && c->user == NULL && c->loader_crc == crc
+				&& c->loader_size == size && memcmp(c->loader, code, size) == 0) {
+			LOG_DEBUG("reusing resident loader at address " TARGET_ADDR_FMT, c->address);
+			c->user = area;
+			*area = c;
+			return ERROR_OK;
+		}
+	}
+
+	retval = target_alloc_working_area(target, size, area);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = target_write_buffer(target, (*area)->address, size, code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, *area);
+		return retval;
+	}
+
+	/* without a host copy the area just behaves like any other */
+	(*area)->loader = malloc(size);
+	if ((*area)->loader) {
+		memcpy((*area)->loader, code, size);
+		(*area)->loader_size = size;
+		(*area)->loader_crc = crc;
+	}
+
+	return ERROR_OK;
+}
+
 static int target_restore_working_area(struct target *target, struct working_area *area)
 {
 	int retval = ERROR_OK;
@@ -1906,6 +2102,14 @@ static int target_free_working_area_restore(struct target *target, struct workin
 	if (area->free)
 		return retval;
 
+	/* Resident loaders stay allocated, they are only released by their user */
+	if (area->loader) {
+		if (area->user)
+			*area->user = NULL;
+		area->user = NULL;
+		return retval;
+	}
+
 	if (restore) {
 		retval = target_restore_working_area(target, area);
 		/* REVISIT: Perhaps the area should be freed even if restoring fails. */
@@ -1949,10 +2153,13 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 	/* Loop through all areas, restoring the allocated ones and marking them as free */
 	while (c) {
 		if (!c->free) {
+			free(c->loader);
+			c->loader = NULL;
 			if (restore)
 				target_restore_working_area(target, c);
 			c->free = true;
-			*c->user = NULL; /* Same as above */
+			if (c->user)
+				*c->user = NULL; /* Same as above */
 			c->user = NULL;
 		}
 		c = c->next;
@@ -1977,18 +2184,25 @@ void target_free_all_working_areas(struct target *target)
 	}
 }
 
-/* Find the largest number of bytes that can be allocated */
+/* Find the largest number of bytes that can be allocated. Idle resident
+ * loaders count as free, an allocation releases them if needed. */
 uint32_t target_get_working_area_avail(struct target *target)
 {
 	struct working_area *c = target->working_areas;
 	uint32_t max_size = 0;
+	uint32_t size = 0;
 
 	if (c == NULL)
 		return target->working_area_size;
 
 	while (c) {
-		if (c->free && max_size < c->size)
-			max_size = c->size;
+		if (c->free || (c->loader && c->user == NULL))
+			size += c->size;
+		else
+			size = 0;
+
+		if (max_size < size)
+			max_size = size;
 
 		c = c->next;
 	}
@@ -2169,6 +2383,8 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	target_generation++;
+	target_invalidate_loaders(target, address, size);
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
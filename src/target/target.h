@@ -100,6 +100,10 @@ struct working_area {
 	uint8_t *backup;
 	struct working_area **user;
 	struct working_area *next;
+	/* host copy of the loader code kept resident in this area, if any */
+	uint8_t *loader;
+	uint32_t loader_size;
+	uint32_t loader_crc;
 };
 
 struct gdb_service {
@@ -398,6 +402,20 @@ int target_call_timer_callbacks(void);
  * a synchronous command completes.
  */
 int target_call_timer_callbacks_now(void);
+/**
+ * Returns the time in ms (as returned by timeval_ms()) at which the
+ * earliest registered timer callback is due. The server loop uses this
+ * to sleep exactly until the next deadline instead of a fixed period.
+ */
+int64_t target_timer_next_event(void);
+
+/**
+ * Returns a counter that changes whenever any target may have changed
+ * state or memory contents, i.e. on target events (halt, resume, reset...),
+ * steps, algorithm runs and memory writes. While it keeps its value, data
+ * read from halted targets can be reused.
+ */
+uint32_t target_get_generation(void);
 
 struct target *get_target_by_num(int num);
 struct target *get_current_target(struct command_context *cmd_ctx);
@@ -501,6 +519,16 @@ int target_get_gdb_reg_list(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class);
 
+/**
+ * Read the invalid registers of @a reg_list in one batch, if the target
+ * supports it. Registers that are still invalid afterwards have to be
+ * read one by one through reg->type->get().
+ *
+ * This routine is a wrapper for target->type->read_registers.
+ */
+int target_read_registers(struct target *target,
+		struct reg **reg_list, int reg_list_size);
+
 /**
  * Check if @a target allows GDB connections.
  *
@@ -683,6 +711,16 @@ int target_alloc_working_area(struct target *target,
  */
 int target_alloc_working_area_try(struct target *target,
 		uint32_t size, struct working_area **area);
+/* Allocate a working area holding the given code, e.g. a flash loader.
+ *
+ * The area stays resident after target_free_working_area(), so the next
+ * call with identical code returns it again without uploading anything.
+ * Resident loaders are dropped when the target resumes, steps, is reset
+ * or is found running, when the target memory they occupy is written,
+ * or when their space is needed for another allocation.
+ */
+int target_alloc_loader(struct target *target, const uint8_t *code,
+		uint32_t size, struct working_area **area);
 int target_free_working_area(struct target *target, struct working_area *area);
 void target_free_all_working_areas(struct target *target);
 uint32_t target_get_working_area_avail(struct target *target);
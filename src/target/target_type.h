@@ -111,6 +111,16 @@ struct target_type {
 	int (*get_gdb_reg_list)(struct target *target, struct reg **reg_list[],
 			int *reg_list_size, enum target_register_class reg_class);
 
+	/**
+	 * Optional. Reads the values of all invalid registers in @a reg_list
+	 * at once, e.g. with a single queued transfer, instead of one
+	 * reg->type->get() round trip per register. Registers it can't read
+	 * this way are left invalid. Do @b not call this function directly,
+	 * use target_read_registers() instead.
+	 */
+	int (*read_registers)(struct target *target, struct reg **reg_list,
+			int reg_list_size);
+
 	/* target memory access
 	* size: 1 = byte (8bit), 2 = half-word (16bit), 4 = word (32bit)
 	* count: number of items of <size>